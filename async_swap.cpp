@@ -0,0 +1,348 @@
+#include "async_swap.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------- io_uring
+
+uring_engine::uring_engine(int fd, unsigned entries)
+    : ring_fd(-1), fd(fd), entries(0), in_flight(0), sq_ring(MAP_FAILED), sq_ring_size(0),
+      cq_ring(MAP_FAILED), cq_ring_size(0), sqes((struct io_uring_sqe*)MAP_FAILED), sqes_size(0) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int rfd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(rfd < 0)
+        return;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQ_RING);
+    cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_CQ_RING);
+    sqes = (struct io_uring_sqe*)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQES);
+    if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        close(rfd);
+        return;
+    }
+
+    char* sq = (char*)sq_ring;
+    sq_head = (unsigned*)(sq + params.sq_off.head);
+    sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)cq_ring;
+    cq_head = (unsigned*)(cq + params.cq_off.head);
+    cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    this->entries = params.sq_entries;
+    ring_fd = rfd;
+}
+
+uring_engine::~uring_engine() {
+    while (in_flight > 0)
+        reap(true);
+    if(sq_ring != MAP_FAILED)
+        munmap(sq_ring, sq_ring_size);
+    if(cq_ring != MAP_FAILED)
+        munmap(cq_ring, cq_ring_size);
+    if(sqes != MAP_FAILED)
+        munmap(sqes, sqes_size);
+    if(ring_fd != -1)
+        close(ring_fd);
+}
+
+// collects finished requests, with block it waits for at least one
+void uring_engine::reap(bool block) {
+    while (true) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if(head != tail) {
+            for (; head != tail; head++) {
+                struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+                swap_request* request = (swap_request*)(uintptr_t)cqe->user_data;
+                request->result = cqe->res;
+                request->done = true;
+                in_flight--;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            return;
+        }
+        if(!block)
+            return;
+        syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+}
+
+void uring_engine::submit(swap_request* request) {
+    // never more requests in flight than submission entries, the completion ring is twice as big
+    while (in_flight >= entries)
+        reap(true);
+
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = request->offset;
+    sqe->addr = (uintptr_t)request->iov.data();
+    sqe->len = (unsigned)request->iov.size();
+    sqe->user_data = (uintptr_t)request;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    in_flight++;
+
+    while (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, NULL, 0) < 0) {
+        if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            break;
+        reap(false);
+    }
+}
+
+void uring_engine::wait(swap_request* request) {
+    while (!request->done)
+        reap(true);
+}
+
+// ---------------------------------------------------------------- worker thread
+
+thread_engine::thread_engine(int fd) : fd(fd), stopping(false), worker(&thread_engine::run, this) {}
+
+thread_engine::~thread_engine() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_one();
+    worker.join();
+}
+
+void thread_engine::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        work_ready.wait(guard, [this] { return stopping || !queue.empty(); });
+        if(queue.empty())
+            return; // stopping, and everything queued is done
+        swap_request* request = queue.front();
+        queue.pop_front();
+        guard.unlock();
+        ssize_t result = request->write
+                ? pwritev(fd, request->iov.data(), (int)request->iov.size(), request->offset)
+                : preadv(fd, request->iov.data(), (int)request->iov.size(), request->offset);
+        guard.lock();
+        request->result = result;
+        request->done = true;
+        work_done.notify_all();
+    }
+}
+
+void thread_engine::submit(swap_request* request) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(request);
+    }
+    work_ready.notify_one();
+}
+
+void thread_engine::wait(swap_request* request) {
+    std::unique_lock<std::mutex> guard(lock);
+    work_done.wait(guard, [request] { return request->done; });
+}
+
+// ---------------------------------------------------------------- async_swap
+
+async_swap::async_swap(int fd, int page_size, int num_slots, int batch_pages, int prefetch_pages, async_mode mode)
+    : fd(fd), page_size(page_size), num_slots(num_slots),
+      batch_pages(std::max(1, std::min(batch_pages, IOV_MAX))), prefetch_pages(std::max(0, prefetch_pages)),
+      engine(nullptr), pending_of(num_slots, nullptr), inflight_of(num_slots, nullptr),
+      prefetch_of(num_slots, nullptr), prefetch_request_of(num_slots, nullptr) {
+    memset(&stats, 0, sizeof(stats));
+    prefetch_limit = 8 * this->prefetch_pages;
+    if(mode == ASYNC_AUTO || mode == ASYNC_URING) {
+        uring_engine* uring = new uring_engine(fd, 64);
+        if(uring->ok())
+            engine = uring;
+        else
+            delete uring;
+    }
+    if(engine == nullptr)
+        engine = new thread_engine(fd);
+}
+
+async_swap::~async_swap() {
+    drain();
+    delete engine;
+    for (char* buffer : free_buffers)
+        delete[] buffer;
+}
+
+char* async_swap::takeBuffer() {
+    if(free_buffers.empty())
+        return new char[page_size];
+    char* buffer = free_buffers.back();
+    free_buffers.pop_back();
+    return buffer;
+}
+
+// waits for a request, a short or failed transfer is redone synchronously
+void async_swap::finish(swap_request* request) {
+    engine->wait(request);
+    if(request->result != (ssize_t)request->length)
+        request->result = request->write
+                ? pwritev(fd, request->iov.data(), (int)request->iov.size(), request->offset)
+                : preadv(fd, request->iov.data(), (int)request->iov.size(), request->offset);
+}
+
+void async_swap::waitInflight() {
+    for (swap_request* request : inflight_requests) {
+        finish(request);
+        delete request;
+    }
+    inflight_requests.clear();
+    for (int slot : inflight_slots) {
+        free_buffers.push_back(inflight_of[slot]);
+        inflight_of[slot] = nullptr;
+    }
+    inflight_slots.clear();
+}
+
+void async_swap::write_page(int slot, const char* src) {
+    dropPrefetch(slot); // about to be stale
+    char* buffer = pending_of[slot];
+    if(buffer == nullptr) {
+        buffer = takeBuffer();
+        pending_of[slot] = buffer;
+        pending_slots.push_back(slot);
+    }
+    memcpy(buffer, src, page_size);
+    if((int)pending_slots.size() >= batch_pages)
+        flush();
+}
+
+void async_swap::flush() {
+    if(pending_slots.empty())
+        return;
+    // one batch in flight at a time, so two writes of the same slot never race
+    waitInflight();
+
+    std::sort(pending_slots.begin(), pending_slots.end());
+    size_t i = 0;
+    while (i < pending_slots.size()) {
+        swap_request* request = new swap_request();
+        request->write = true;
+        request->offset = (off_t)pending_slots[i] * page_size;
+        request->length = 0;
+        request->result = 0;
+        request->done = false;
+        request->refs = 0;
+        // a run of adjacent slots becomes a single vectored write
+        int expected = pending_slots[i];
+        while (i < pending_slots.size() && pending_slots[i] == expected && request->iov.size() < IOV_MAX) {
+            struct iovec v = { pending_of[expected], (size_t)page_size };
+            request->iov.push_back(v);
+            request->length += page_size;
+            expected++;
+            i++;
+        }
+        engine->submit(request);
+        inflight_requests.push_back(request);
+        stats.write_requests++;
+    }
+
+    for (int slot : pending_slots) {
+        inflight_of[slot] = pending_of[slot];
+        pending_of[slot] = nullptr;
+        inflight_slots.push_back(slot);
+    }
+    stats.pages_written += pending_slots.size();
+    pending_slots.clear();
+}
+
+void async_swap::dropPrefetch(int slot) {
+    if(prefetch_of[slot] == nullptr)
+        return;
+    swap_request* request = prefetch_request_of[slot];
+    engine->wait(request); // the buffer may still be the target of the read
+    if(--request->refs == 0)
+        delete request;
+    free_buffers.push_back(prefetch_of[slot]);
+    prefetch_of[slot] = nullptr;
+    prefetch_request_of[slot] = nullptr;
+}
+
+// reads the slots following a synchronous swap-in, they were most likely evicted together
+void async_swap::startPrefetch(int slot) {
+    swap_request* request = nullptr;
+    for (int next = slot + 1; next <= slot + prefetch_pages && next < num_slots; next++) {
+        if(pending_of[next] || inflight_of[next] || prefetch_of[next])
+            break; // the run stops at the first slot already in memory
+        if(request == nullptr) {
+            request = new swap_request();
+            request->write = false;
+            request->offset = (off_t)next * page_size;
+            request->length = 0;
+            request->result = 0;
+            request->done = false;
+            request->refs = 0;
+        }
+        char* buffer = takeBuffer();
+        struct iovec v = { buffer, (size_t)page_size };
+        request->iov.push_back(v);
+        request->length += page_size;
+        request->refs++;
+        prefetch_of[next] = buffer;
+        prefetch_request_of[next] = request;
+        prefetch_order.push_back(next);
+    }
+    if(request == nullptr)
+        return;
+    engine->submit(request);
+    stats.prefetch_issued += request->refs;
+    while ((int)prefetch_order.size() > prefetch_limit) {
+        dropPrefetch(prefetch_order.front());
+        prefetch_order.pop_front();
+    }
+}
+
+ssize_t async_swap::read_page(int slot, char* dst) {
+    // the newest copy of the slot may not have reached the file yet
+    char* buffered = pending_of[slot] ? pending_of[slot] : inflight_of[slot];
+    if(buffered != nullptr) {
+        memcpy(dst, buffered, page_size);
+        stats.buffer_hits++;
+        return page_size;
+    }
+    if(prefetch_of[slot] != nullptr) {
+        swap_request* request = prefetch_request_of[slot];
+        finish(request);
+        bool ok = request->result == (ssize_t)request->length;
+        if(ok)
+            memcpy(dst, prefetch_of[slot], page_size);
+        dropPrefetch(slot);
+        if(ok) {
+            stats.prefetch_hits++;
+            return page_size;
+        }
+    }
+    ssize_t result = pread(fd, dst, page_size, (off_t)slot * page_size);
+    stats.pages_read++;
+    if(prefetch_pages > 0)
+        startPrefetch(slot);
+    return result;
+}
+
+void async_swap::drain() {
+    flush();
+    waitInflight();
+    while (!prefetch_order.empty()) {
+        dropPrefetch(prefetch_order.front());
+        prefetch_order.pop_front();
+    }
+}
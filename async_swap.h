@@ -0,0 +1,144 @@
+#ifndef OS_EX4_ASYNC_SWAP_H
+#define OS_EX4_ASYNC_SWAP_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// how swap traffic is taken off the load/store path
+enum async_mode {
+    ASYNC_OFF,     // every swap read/write is synchronous
+    ASYNC_AUTO,    // io_uring when the kernel allows it, the thread backend otherwise
+    ASYNC_URING,
+    ASYNC_THREADS
+};
+
+// one vectored read or write on the swap file
+struct swap_request {
+    bool write;
+    off_t offset;
+    std::vector<struct iovec> iov;
+    size_t length;  // sum of the iov lengths
+    ssize_t result;
+    bool done;
+    int refs;       // prefetched slots still pointing at this read
+};
+
+// runs swap_requests in the background
+class io_engine {
+public:
+    virtual ~io_engine() {}
+    virtual void submit(swap_request* request) = 0;
+    // blocks until the request completed
+    virtual void wait(swap_request* request) = 0;
+    virtual const char* name() const = 0;
+};
+
+// io_uring driven through the raw syscalls, no liburing needed
+class uring_engine final : public io_engine {
+    int ring_fd;
+    int fd;
+    unsigned entries;
+    unsigned in_flight;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void reap(bool block);
+public:
+    uring_engine(int fd, unsigned entries);
+    ~uring_engine() override;
+    bool ok() const { return ring_fd != -1; }
+    void submit(swap_request* request) override;
+    void wait(swap_request* request) override;
+    const char* name() const override { return "io_uring"; }
+};
+
+// a worker thread doing pwritev/preadv
+class thread_engine final : public io_engine {
+    int fd;
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    std::deque<swap_request*> queue;
+    bool stopping;
+    std::thread worker;
+
+    void run();
+public:
+    explicit thread_engine(int fd);
+    ~thread_engine() override;
+    void submit(swap_request* request) override;
+    void wait(swap_request* request) override;
+    const char* name() const override { return "threads"; }
+};
+
+// asynchronous front of the swap file. evicted pages are copied into a write-back buffer and
+// written in batches, adjacent slots coalesced into one vectored write, while the next batch
+// fills up. reading a slot that is still buffered or being written is served from memory, and
+// every synchronous swap-in starts a read-ahead of the following slots.
+class async_swap {
+public:
+    struct counters {
+        long pages_written;
+        long write_requests;    // vectored writes submitted, pages_written / write_requests is the coalescing
+        long pages_read;        // swap-ins that had to wait for the disk
+        long buffer_hits;       // swap-ins served from the write-back buffer
+        long prefetch_issued;
+        long prefetch_hits;
+    };
+
+private:
+    int fd;
+    int page_size;
+    int num_slots;
+    int batch_pages;
+    int prefetch_pages;
+    io_engine* engine;
+
+    std::vector<char*> pending_of;     // slot -> newest data waiting for the next flush
+    std::vector<int> pending_slots;
+    std::vector<char*> inflight_of;    // slot -> data of the batch being written
+    std::vector<int> inflight_slots;
+    std::vector<swap_request*> inflight_requests;
+    std::vector<char*> prefetch_of;    // slot -> read-ahead buffer
+    std::vector<swap_request*> prefetch_request_of;
+    std::deque<int> prefetch_order;    // oldest read-ahead first, bounds the buffers it holds
+    int prefetch_limit;
+    std::vector<char*> free_buffers;
+    counters stats;
+
+    char* takeBuffer();
+    void finish(swap_request* request);
+    void waitInflight();
+    void dropPrefetch(int slot);
+    void startPrefetch(int slot);
+
+public:
+    async_swap(int fd, int page_size, int num_slots, int batch_pages, int prefetch_pages, async_mode mode);
+    ~async_swap();
+
+    void write_page(int slot, const char* src);
+    // -1 on error, page_size otherwise
+    ssize_t read_page(int slot, char* dst);
+    // submits the pending batch
+    void flush();
+    // everything written so far is on the file once this returns
+    void drain();
+
+    const counters& counts() const { return stats; }
+    const char* backend() const { return engine->name(); }
+};
+
+#endif //OS_EX4_ASYNC_SWAP_H
@@ -0,0 +1,74 @@
+#include "backing_file.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+backing_file::~backing_file() {
+    if(map_addr != nullptr)
+        munmap(map_addr, map_size);
+    if(fd != -1)
+        close(fd);
+}
+
+bool backing_file::open(const char* path, int flags, mode_t permissions) {
+    fd = ::open(path, flags, permissions);
+    return fd != -1;
+}
+
+bool backing_file::map(io_mode mode, bool writable) {
+    if(mode != MMAP_IO || fd == -1)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size == 0)
+        return false;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, st.st_size, prot, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED)
+        return false;
+    map_addr = (char*)addr;
+    map_size = st.st_size;
+    return true;
+}
+
+void backing_file::advise(int advice) {
+    if(map_addr != nullptr)
+        madvise(map_addr, map_size, advice);
+}
+
+ssize_t backing_file::read(char* dst, off_t offset, size_t len) {
+    if(map_addr != nullptr && offset >= 0) {
+        if((size_t)offset >= map_size)
+            return 0; // end of file
+        size_t available = map_size - offset;
+        if(len > available)
+            len = available;
+        memcpy(dst, map_addr + offset, len);
+        return len;
+    }
+    return pread(fd, dst, len, offset);
+}
+
+ssize_t backing_file::readv(const struct iovec* buffers, int count, off_t offset) {
+    if(map_addr != nullptr && offset >= 0) {
+        ssize_t done = 0;
+        for (int i = 0; i < count; i++) {
+            ssize_t n = read((char*)buffers[i].iov_base, offset + done, buffers[i].iov_len);
+            done += n;
+            if((size_t)n < buffers[i].iov_len)
+                break;
+        }
+        return done;
+    }
+    return preadv(fd, buffers, count, offset);
+}
+
+ssize_t backing_file::write(const char* src, off_t offset, size_t len) {
+    if(map_addr != nullptr && offset >= 0 && (size_t)offset + len <= map_size) {
+        memcpy(map_addr + offset, src, len);
+        return len;
+    }
+    return pwrite(fd, src, len, offset);
+}
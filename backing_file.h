@@ -0,0 +1,45 @@
+#ifndef OS_EX4_BACKING_FILE_H
+#define OS_EX4_BACKING_FILE_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <cstddef>
+
+// how pages move between the simulator and its files
+enum io_mode {
+    SYSCALL_IO, // pread/pwrite per page
+    MMAP_IO     // the file is mapped, a page transfer is a memcpy
+};
+
+// a file pages are read from and written to (the exec file or the swap file).
+// in MMAP_IO mode the whole file is mapped once and accesses inside the mapping are memcpy,
+// anything the mapping can't serve (no mapping, past its end) goes through pread/pwrite, which
+// keep no file offset, so threads can share a backing_file.
+class backing_file {
+    int fd;
+    char* map_addr;
+    size_t map_size;
+
+public:
+    backing_file() : fd(-1), map_addr(nullptr), map_size(0) {}
+    ~backing_file();
+    backing_file(const backing_file&) = delete;
+    backing_file& operator=(const backing_file&) = delete;
+
+    bool open(const char* path, int flags, mode_t permissions = 0);
+    // maps the file as it is now, writable mappings are shared so writes reach the file.
+    // false if the file stays on the syscall path (SYSCALL_IO, empty file, mmap failed)
+    bool map(io_mode mode, bool writable);
+    void advise(int advice);
+
+    // same contract as read/write: bytes transferred, short at end of file, -1 on error
+    ssize_t read(char* dst, off_t offset, size_t len);
+    ssize_t write(const char* src, off_t offset, size_t len);
+    // scatter read of consecutive file bytes into the buffers, one preadv on the syscall path
+    ssize_t readv(const struct iovec* buffers, int count, off_t offset);
+
+    bool mapped() const { return map_addr != nullptr; }
+    int descriptor() const { return fd; }
+};
+
+#endif //OS_EX4_BACKING_FILE_H
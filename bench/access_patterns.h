@@ -0,0 +1,152 @@
+// synthetic access streams for the benchmarks. every generator yields byte offsets into a
+// region of `pages` pages, the caller adds the region's base address and decides load/store.
+#ifndef OS_EX4_ACCESS_PATTERNS_H
+#define OS_EX4_ACCESS_PATTERNS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+enum pattern_kind {
+    SEQUENTIAL_PATTERN, // byte after byte, wrapping at the end of the region
+    STRIDED_PATTERN,    // jumps of `stride` bytes, wrapping
+    UNIFORM_PATTERN,    // every byte equally likely
+    ZIPF_PATTERN,       // pages by a Zipf(theta) popularity, hot pages scattered over the region
+    LOOP_PATTERN,       // page after page over a working set larger than memory, the LRU worst case
+    PHASE_PATTERN       // uniform over a hot window that moves to another part of the region every phase
+};
+
+static const pattern_kind all_patterns[] = {SEQUENTIAL_PATTERN, STRIDED_PATTERN, UNIFORM_PATTERN,
+                                            ZIPF_PATTERN, LOOP_PATTERN, PHASE_PATTERN};
+
+inline const char* pattern_name(pattern_kind kind) {
+    switch (kind) {
+        case SEQUENTIAL_PATTERN: return "sequential";
+        case STRIDED_PATTERN: return "strided";
+        case UNIFORM_PATTERN: return "uniform";
+        case ZIPF_PATTERN: return "zipf";
+        case LOOP_PATTERN: return "loop";
+        case PHASE_PATTERN: return "phase";
+        default: return "unknown";
+    }
+}
+
+inline bool parse_pattern(const char* name, pattern_kind* kind) {
+    for (pattern_kind candidate : all_patterns) {
+        if(strcmp(name, pattern_name(candidate)) == 0) {
+            *kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// xorshift64*, fast and the same on every machine
+struct bench_rng {
+    uint64_t state;
+    explicit bench_rng(uint64_t seed) : state(seed * 2 + 1) {}
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+    // uniform in [0, 1)
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    uint64_t below(uint64_t n) { return next() % n; }
+};
+
+struct pattern_params {
+    long stride = 0;            // STRIDED_PATTERN, 0 means one page plus 8 bytes
+    double zipf_theta = 0.99;   // ZIPF_PATTERN skew
+    long loop_pages = 0;        // LOOP_PATTERN working set, 0 means the whole region
+    long phase_length = 50000;  // PHASE_PATTERN accesses per phase
+    long phase_pages = 0;       // PHASE_PATTERN hot window, 0 means an eighth of the region
+    double write_ratio = 0.3;   // share of stores
+};
+
+class access_pattern {
+    pattern_kind kind;
+    pattern_params params;
+    long page_size;
+    uint64_t pages;
+    uint64_t size;
+    bench_rng rng;
+    uint64_t position;
+    long count;
+    // Zipf, the YCSB (Gray et al.) rejection-free generator
+    double zeta_n, alpha, eta, half_pow_theta;
+
+public:
+    access_pattern(pattern_kind kind, const pattern_params& params, long page_size, long pages, uint64_t seed)
+        : kind(kind), params(params), page_size(page_size), pages(pages), size((uint64_t)pages * page_size),
+          rng(seed), position(0), count(0), zeta_n(0), alpha(0), eta(0), half_pow_theta(0) {
+        if(this->params.stride <= 0)
+            this->params.stride = page_size + 8;
+        if(this->params.loop_pages <= 0 || (uint64_t)this->params.loop_pages > this->pages)
+            this->params.loop_pages = pages;
+        if(this->params.phase_pages <= 0 || (uint64_t)this->params.phase_pages > this->pages)
+            this->params.phase_pages = pages / 8 > 0 ? pages / 8 : 1;
+        if(kind == ZIPF_PATTERN) {
+            double theta = this->params.zipf_theta;
+            for (long i = 1; i <= pages; i++)
+                zeta_n += 1.0 / pow((double)i, theta);
+            double zeta_2 = 1.0 + pow(0.5, theta);
+            alpha = 1.0 / (1.0 - theta);
+            eta = (1.0 - pow(2.0 / pages, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+            half_pow_theta = pow(0.5, theta);
+        }
+    }
+
+    pattern_kind type() const { return kind; }
+
+    bool next_is_store() { return rng.unit() < params.write_ratio; }
+
+    uint64_t next() {
+        count++;
+        switch (kind) {
+            case SEQUENTIAL_PATTERN: {
+                uint64_t offset = position;
+                position = position + 1 == size ? 0 : position + 1;
+                return offset;
+            }
+            case STRIDED_PATTERN: {
+                uint64_t offset = position;
+                position = (position + params.stride) % size;
+                return offset;
+            }
+            case UNIFORM_PATTERN:
+                return rng.below(size);
+            case ZIPF_PATTERN: {
+                double u = rng.unit();
+                double uz = u * zeta_n;
+                uint64_t rank;
+                if(uz < 1.0)
+                    rank = 0;
+                else if(uz < 1.0 + half_pow_theta)
+                    rank = 1;
+                else
+                    rank = (uint64_t)(pages * pow(eta * u - eta + 1.0, alpha));
+                if(rank >= pages)
+                    rank = pages - 1;
+                // scatter the ranks so the hot pages aren't neighbours
+                uint64_t page = (rank * 0x9E3779B97F4A7C15ULL >> 17) % pages;
+                return page * page_size + rng.below(page_size);
+            }
+            case LOOP_PATTERN: {
+                uint64_t page = position;
+                position = position + 1 == (uint64_t)params.loop_pages ? 0 : position + 1;
+                return page * page_size + rng.below(page_size);
+            }
+            case PHASE_PATTERN: {
+                uint64_t phase = (count - 1) / params.phase_length;
+                uint64_t windows = pages / params.phase_pages;
+                uint64_t first = (phase * 7 % (windows > 0 ? windows : 1)) * params.phase_pages;
+                return (first + rng.below(params.phase_pages)) * page_size + rng.below(page_size);
+            }
+        }
+        return 0;
+    }
+};
+
+#endif //OS_EX4_ACCESS_PATTERNS_H
@@ -0,0 +1,68 @@
+// checkpoints: how long a warm-up of random stores over the heap takes against saving its end
+// state and restoring it into a fresh simulator (its construction included), for a few heap
+// sizes. memory is a quarter of
+// the heap so the warm-up keeps swapping. output is CSV.
+//
+//   bench/bench_checkpoint [accesses] [page_size]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int accesses = argc > 1 ? atoi(argv[1]) : 1000000;
+    int page_size = argc > 2 ? atoi(argv[2]) : 4096;
+
+    const char* exec_name = "bench_checkpoint_exec";
+    const char* swap_name = "bench_checkpoint_swap";
+    const char* restored_swap_name = "bench_checkpoint_swap2";
+    const char* checkpoint_name = "bench_checkpoint.bin";
+    FILE* f = fopen(exec_name, "w");
+    fputs("text", f);
+    fclose(f);
+
+    printf("pages,frames,warmup_ms,save_ms,restore_ms,checkpoint_bytes,swap_bytes\n");
+    for (int pages = 1024; pages <= 16384; pages *= 4) {
+        sim_config config;
+        config.memory_size = (long long)pages / 4 * page_size;
+        config.address_size = 40;
+        uint64_t heap = (uint64_t)HEAP_STACK_SEGMENT << 38;
+
+        auto start = std::chrono::steady_clock::now();
+        sim_mem warm(exec_name, swap_name, 0, 0, 0, pages * page_size, page_size, config);
+        srand(9);
+        for (int i = 0; i < accesses; i++)
+            warm.store(heap + (uint64_t)(rand() % pages) * page_size + rand() % page_size, 'a' + i % 26);
+        double warmup = ms_since(start);
+
+        start = std::chrono::steady_clock::now();
+        if(!warm.save_checkpoint(checkpoint_name))
+            return 1;
+        double save = ms_since(start);
+
+        start = std::chrono::steady_clock::now();
+        sim_mem restored(exec_name, restored_swap_name, 0, 0, 0, pages * page_size, page_size, config);
+        if(!restored.restore_checkpoint(checkpoint_name))
+            return 1;
+        double restore = ms_since(start);
+
+        struct stat checkpoint, swap;
+        stat(checkpoint_name, &checkpoint);
+        stat((std::string(checkpoint_name) + ".swap").c_str(), &swap);
+        printf("%d,%d,%.1f,%.1f,%.1f,%lld,%lld\n", pages, pages / 4, warmup, save, restore,
+               (long long)checkpoint.st_size, (long long)swap.st_size);
+        fflush(stdout);
+    }
+    unlink(checkpoint_name);
+    unlink((std::string(checkpoint_name) + ".swap").c_str());
+    unlink(swap_name);
+    unlink(restored_swap_name);
+    unlink(exec_name);
+    return 0;
+}
@@ -0,0 +1,73 @@
+// compares page-in/page-out throughput of the I/O modes: syscalls, mmap, and asynchronous
+// write-back swap on io_uring or a worker thread. the access pattern cycles over
+// more pages than fit in memory so under LRU every access is a fault: DATA pages come from
+// the exec file, HEAP_STACK pages go back and forth through the swap file.
+//
+//   bench/bench_io [page_size] [pages_per_segment] [frames] [rounds]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+static volatile long sink; // keeps the loads from being optimized away
+
+static double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double run(io_mode mode, async_mode async, const char* exec_name, int page_size, int pages, int frames, int rounds,
+                  long* faults) {
+    sim_config config;
+    config.io = mode;
+    config.async_io = async;
+    config.memory_size = (long long)frames * page_size;
+    config.address_size = 32;
+    int segment_size = pages * page_size;
+    sim_mem mem(exec_name, "bench_io_swap", page_size, segment_size, 0, segment_size, page_size, config);
+
+    uint64_t data = 1ULL << 30, heap = 3ULL << 30;
+    for (int p = 0; p < pages; p++)
+        mem.store(heap + (uint64_t)p * page_size, 'h');
+
+    long checksum = 0;
+    double start = now_sec();
+    for (int r = 0; r < rounds; r++) {
+        for (int p = 0; p < pages; p++) {
+            checksum += mem.load(data + (uint64_t)p * page_size);
+            checksum += mem.load(heap + (uint64_t)p * page_size);
+        }
+    }
+    double elapsed = now_sec() - start;
+    *faults = 2L * rounds * pages;
+    unlink("bench_io_swap");
+    sink = checksum;
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    int page_size = argc > 1 ? atoi(argv[1]) : 4096;
+    int pages = argc > 2 ? atoi(argv[2]) : 128;
+    int frames = argc > 3 ? atoi(argv[3]) : 64;
+    int rounds = argc > 4 ? atoi(argv[4]) : 200;
+
+    // an exec file covering TEXT + DATA (+ HEAP_STACK for the layout)
+    const char* exec_name = "bench_io_exec";
+    FILE* f = fopen(exec_name, "w");
+    std::vector<char> page(page_size, 'x');
+    for (int p = 0; p < 3 * pages; p++)
+        fwrite(page.data(), 1, page.size(), f);
+    fclose(f);
+
+    printf("page_size=%d pages/segment=%d frames=%d rounds=%d\n", page_size, pages, frames, rounds);
+    const io_mode modes[] = {SYSCALL_IO, MMAP_IO, SYSCALL_IO, SYSCALL_IO};
+    const async_mode asyncs[] = {ASYNC_OFF, ASYNC_OFF, ASYNC_URING, ASYNC_THREADS};
+    const char* names[] = {"syscall", "mmap", "io_uring", "threads"};
+    for (int m = 0; m < 4; m++) {
+        long faults;
+        double elapsed = run(modes[m], asyncs[m], exec_name, page_size, pages, frames, rounds, &faults);
+        printf("%-8s %10.0f faults/s  (%ld faults in %.3f s)\n", names[m], faults / elapsed, faults, elapsed);
+    }
+    unlink(exec_name);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// large pages: the same mix of text and heap accesses with base pages only, large text pages,
+// large text and heap pages and with promotion of resident base pages. text is a loop over its
+// hot half, the heap has a hot set of half a memory's worth of pages and 2% of its accesses go
+// anywhere.
+// reports faults, pages the large faults mapped, swap I/O operations, TLB hit rate and access
+// cost. output is CSV.
+//
+//   bench/bench_large_pages [large_page_pages] [accesses] [page_size]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char** argv) {
+    int large = argc > 1 ? atoi(argv[1]) : 16;
+    int accesses = argc > 2 ? atoi(argv[2]) : 2000000;
+    int page_size = argc > 3 ? atoi(argv[3]) : 4096;
+    int text_pages = 1024, heap_pages = 4096, frames = 2048;
+
+    const char* exec_name = "bench_large_pages_exec";
+    const char* swap_name = "bench_large_pages_swap";
+    FILE* f = fopen(exec_name, "w");
+    std::vector<char> code((size_t)text_pages * page_size, 'x');
+    fwrite(code.data(), 1, code.size(), f);
+    fclose(f);
+
+    printf("config,faults,large_fault_pages,promotions,demotions,evictions,swap_reads,swap_writes,"
+           "large_ios,tlb_hit_rate,ns_per_access\n");
+    const char* names[] = {"base", "large_text", "large_text_heap", "promote"};
+    for (int run = 0; run < 4; run++) {
+        sim_config config;
+        config.memory_size = (long long)frames * page_size;
+        config.address_size = 40;
+        if(run == 1 || run == 2)
+            config.segment_page_size[TEXT_SEGMENT] = large * page_size;
+        if(run == 2)
+            config.segment_page_size[HEAP_STACK_SEGMENT] = large * page_size;
+        if(run == 3)
+            config.promote_order = __builtin_ctz(large);
+        sim_mem mem(exec_name, swap_name, text_pages * page_size, 0, 0, heap_pages * page_size, page_size, config);
+        uint64_t heap = (uint64_t)HEAP_STACK_SEGMENT << 38;
+        // every heap page is stored to first, so any of them may be loaded
+        for (int p = 0; p < heap_pages; p++)
+            mem.store(heap + (uint64_t)p * page_size, 'h');
+
+        srand(7);
+        long pc = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < accesses; i++) {
+            if(rand() % 10 < 3) {
+                mem.load(pc);
+                pc = (pc + 64) % ((long)text_pages / 2 * page_size);
+                continue;
+            }
+            int page = rand() % 100 < 98 ? rand() % (frames / 2) : rand() % heap_pages;
+            uint64_t address = heap + (uint64_t)page * page_size + rand() % page_size;
+            if(rand() % 10 < 3)
+                mem.store(address, 'w');
+            else
+                mem.load(address);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        segment_stats total = mem.stats().total();
+        swap_usage swap = mem.swap_slot_usage();
+        tlb_usage tlb = mem.tlb_stats();
+        printf("%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.3f,%.1f\n", names[run], total.major_faults + total.minor_faults,
+               total.large_fault_pages, total.promotions, total.demotions,
+               total.clean_evictions + total.dirty_evictions, swap.reads, swap.writes, total.large_ios,
+               tlb.hits + tlb.misses == 0 ? 0.0 : (double)tlb.hits / (tlb.hits + tlb.misses), ns / accesses);
+        fflush(stdout);
+    }
+    unlink(swap_name);
+    unlink(exec_name);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// page descriptor layout: footprint and full-table scan speed of the packed 8 byte descriptor
+// against the previous 16 byte one (a bool or an int per field). the scan is the one rss()
+// does, count the valid pages and look up their frames' mappers. output is CSV.
+//
+//   bench/bench_page_scan [pages] [frames] [rounds]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+// the layout before the descriptor was packed
+typedef struct wide_descriptor {
+    bool valid;
+    int frame;
+    bool dirty;
+    bool in_swap;
+    bool prefetched;
+    int swap_index;
+} wide_descriptor;
+
+static volatile long sink;
+
+template <class Descriptor>
+static void fill(std::vector<Descriptor>& table, int frames) {
+    srand(11);
+    for (size_t i = 0; i < table.size(); i++) {
+        Descriptor &page = table[i];
+        page.valid = rand() % 4 == 0;
+        page.dirty = page.valid && rand() % 2 == 0;
+        page.in_swap = !page.valid && rand() % 2 == 0;
+        page.prefetched = false;
+        page.frame = page.valid ? rand() % frames : -1;
+        page.swap_index = page.in_swap ? (int)i : -1;
+    }
+}
+
+// ns per descriptor of the scan
+template <class Descriptor>
+static double scan(const std::vector<Descriptor>& table, const std::vector<int>& mappers, int rounds) {
+    long resident = 0, shared = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const Descriptor &page : table) {
+            if(!page.valid)
+                continue;
+            resident++;
+            if(mappers[page.frame] > 1)
+                shared++;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    sink = resident + shared;
+    return ns / ((double)rounds * table.size());
+}
+
+int main(int argc, char** argv) {
+    long pages = argc > 1 ? atol(argv[1]) : 4 * 1024 * 1024;
+    int frames = argc > 2 ? atoi(argv[2]) : 65536;
+    int rounds = argc > 3 ? atoi(argv[3]) : 10;
+
+    std::vector<int> mappers(frames);
+    for (int i = 0; i < frames; i++)
+        mappers[i] = 1 + (i % 16 == 0);
+
+    std::vector<wide_descriptor> wide(pages);
+    std::vector<page_descriptor> packed(pages);
+    fill(wide, frames);
+    fill(packed, frames);
+
+    printf("layout,descriptor_bytes,pages,table_bytes,ns_per_page\n");
+    printf("wide,%zu,%ld,%zu,%.3f\n", sizeof(wide_descriptor), pages, pages * sizeof(wide_descriptor),
+           scan(wide, mappers, rounds));
+    printf("packed,%zu,%ld,%zu,%.3f\n", sizeof(page_descriptor), pages, pages * sizeof(page_descriptor),
+           scan(packed, mappers, rounds));
+    return 0;
+}
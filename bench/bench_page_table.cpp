@@ -0,0 +1,65 @@
+// page table layouts: footprint and lookup cost of the flat table against 3 and 4 level radix
+// tables, over a heap touched in a few scattered regions. every load goes through the page
+// table (the TLB is off) and hits a resident page. output is CSV.
+//
+//   bench/bench_page_table [heap_pages] [regions] [region_pages] [page_size]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+
+static volatile char sink;
+
+int main(int argc, char** argv) {
+    long heap_pages = argc > 1 ? atol(argv[1]) : 65536;
+    long regions = argc > 2 ? atol(argv[2]) : 16;
+    long region_pages = argc > 3 ? atol(argv[3]) : 32;
+    long page_size = argc > 4 ? atol(argv[4]) : 32;
+    long touched = regions * region_pages;
+
+    const char* exec_name = "bench_page_table_exec";
+    const char* swap_name = "bench_page_table_swap";
+    FILE* f = fopen(exec_name, "w");
+    for (long i = 0; i < page_size; i++)
+        fputc('a' + i % 26, f);
+    fclose(f);
+
+    // the regions are spread evenly over the heap
+    std::vector<uint64_t> pages;
+    for (long r = 0; r < regions; r++) {
+        long first = heap_pages / regions * r;
+        for (long p = 0; p < region_pages && first + p < heap_pages; p++)
+            pages.push_back((uint64_t)(first + p));
+    }
+
+    printf("levels,heap_pages,touched_pages,table_bytes,bytes_per_touched_page,ns_per_load\n");
+    for (int levels = 2; levels <= 4; levels++) {
+        sim_config config;
+        config.memory_size = (touched + 1) * page_size;
+        config.address_size = 40;
+        config.tlb_entries = 0;
+        config.page_table_levels = levels;
+        sim_mem mem(exec_name, swap_name, 0, 0, 0, (int)(heap_pages * page_size), (int)page_size, config);
+        uint64_t heap = (uint64_t)HEAP_STACK_SEGMENT << 38;
+        for (uint64_t page : pages)
+            mem.store(heap + page * page_size, 1);
+
+        long rounds = 20000000 / (long)pages.size() + 1;
+        char checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long round = 0; round < rounds; round++) {
+            for (uint64_t page : pages)
+                checksum ^= mem.load(heap + page * page_size + round % page_size);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        sink = checksum;
+
+        size_t bytes = mem.page_table_bytes();
+        printf("%d,%ld,%zu,%zu,%.1f,%.2f\n", levels, heap_pages, pages.size(), bytes,
+               (double)bytes / pages.size(), ns / ((double)rounds * pages.size()));
+        fflush(stdout);
+    }
+    unlink(swap_name);
+    unlink(exec_name);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// page-out daemon: a heap four times larger than memory with a hot set of half the frames that
+// gets 95% of the accesses, a third of them stores. run without the daemon, with it evicting only
+// and with it writing back dirty pages near eviction too, single threaded and in concurrent mode.
+// reports how many faults still reclaimed directly, the daemon's work, the swap writes and the
+// fault latency. output is CSV.
+//
+//   bench/bench_pageout [frames] [accesses] [threads]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static const int page_size = 256;
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 1024;
+    long accesses = argc > 2 ? atol(argv[2]) : 2000000;
+    int threads = argc > 3 ? atoi(argv[3]) : 4;
+    int pages = frames * 4;
+
+    FILE* f = fopen("bench_pageout_exec", "w");
+    fputs("text", f);
+    fclose(f);
+
+    printf("config,mode,threads,faults,direct_reclaims,background_reclaims,writebacks,dirty_evictions,swap_writes,"
+           "fault_mean_ns,fault_p99_ns,ns_per_access\n");
+    const char* names[] = {"off", "evict", "evict_clean"};
+    for (int concurrent = 0; concurrent < 2; concurrent++) {
+        for (int run = 0; run < 3; run++) {
+            sim_config config;
+            config.memory_size = (long long)frames * page_size;
+            config.address_size = 32;
+            config.concurrent = concurrent == 1;
+            if(run > 0) {
+                config.pageout_low = frames / 32;
+                config.pageout_high = frames / 16;
+                config.pageout_clean = run == 2 ? 16 : 0;
+            }
+            sim_mem mem("bench_pageout_exec", "bench_pageout_swap", 0, 0, 0, pages * page_size, page_size, config);
+            uint64_t heap = 3ULL << 30;
+            for (int p = 0; p < pages; p++)
+                mem.store(heap + (uint64_t)p * page_size, 'h');
+            sim_stats before = mem.stats();
+
+            int workers = concurrent ? threads : 1;
+            auto worker = [&](int id) {
+                unsigned seed = id + 1;
+                for (long i = 0; i < accesses / workers; i++) {
+                    int page = rand_r(&seed) % 100 < 95 ? rand_r(&seed) % (frames / 2) : rand_r(&seed) % pages;
+                    uint64_t address = heap + (uint64_t)page * page_size + rand_r(&seed) % page_size;
+                    if(rand_r(&seed) % 3 == 0)
+                        mem.store(address, 'w');
+                    else
+                        mem.load(address);
+                }
+            };
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> running;
+            for (int t = 0; t < workers; t++)
+                running.emplace_back(worker, t);
+            for (std::thread& t : running)
+                t.join();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            sim_stats after = mem.stats();
+            segment_stats total = after.total(), initial = before.total();
+            // the warm-up's faults are in the histogram too, the latencies cover the whole run
+            latency_histogram &latency = after.major_fault_ns;
+            printf("%s,%s,%d,%ld,%ld,%ld,%ld,%ld,%ld,%.0f,%llu,%.1f\n", names[run],
+                   concurrent ? "concurrent" : "single", workers,
+                   total.major_faults + total.minor_faults - initial.major_faults - initial.minor_faults,
+                   total.direct_reclaims - initial.direct_reclaims,
+                   total.background_reclaims - initial.background_reclaims, total.writebacks - initial.writebacks,
+                   total.dirty_evictions - initial.dirty_evictions, mem.swap_slot_usage().writes, latency.mean(),
+                   (unsigned long long)latency.percentile(99), ns / accesses);
+            fflush(stdout);
+        }
+    }
+    unlink("bench_pageout_swap");
+    unlink("bench_pageout_exec");
+    return 0;
+}
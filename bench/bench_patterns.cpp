@@ -0,0 +1,112 @@
+// regression benchmark: drives sim_mem with the synthetic access patterns over a sweep of page
+// and memory sizes and prints ns/access, fault rate and swap I/O per run as CSV or JSON lines.
+// the patterns run over the heap, which is stored to once before measuring so every page exists.
+//
+//   bench/bench_patterns [accesses] [footprint_bytes] [csv|json] [pattern]
+#include "sim_mem.h"
+#include "access_patterns.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+typedef struct pattern_result {
+    double ns_per_access;
+    long faults;
+    long major_faults;
+    long swap_reads;
+    long swap_writes;
+    long long io_bytes;
+} pattern_result;
+
+static volatile char sink;
+
+static pattern_result run(pattern_kind kind, long page_size, long long memory, long footprint, long accesses,
+                          const char* exec_name, const char* swap_name) {
+    sim_config config;
+    config.memory_size = memory;
+    config.address_size = 32;
+    sim_mem mem(exec_name, swap_name, 0, 0, 0, footprint, page_size, config);
+    uint64_t heap = 3ULL << 30;
+    long pages = footprint / page_size;
+    for (long p = 0; p < pages; p++)
+        mem.store(heap + (uint64_t)p * page_size, 'h');
+
+    pattern_params params;
+    // the loop is half as large again as memory, LRU misses on every page
+    params.loop_pages = (long)(memory / page_size * 3 / 2);
+    access_pattern pattern(kind, params, page_size, pages, 42);
+    segment_stats before = mem.stats().total();
+    swap_usage swap_before = mem.swap_slot_usage();
+
+    char checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < accesses; i++) {
+        uint64_t address = heap + pattern.next();
+        if(pattern.next_is_store())
+            mem.store(address, (char)i);
+        else
+            checksum ^= mem.load(address);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    sink = checksum; // keeps the loads alive
+
+    segment_stats after = mem.stats().total();
+    swap_usage swap_after = mem.swap_slot_usage();
+    pattern_result result;
+    result.ns_per_access = ns / accesses;
+    result.major_faults = after.major_faults - before.major_faults;
+    result.faults = result.major_faults + after.minor_faults - before.minor_faults;
+    result.swap_reads = swap_after.reads - swap_before.reads;
+    result.swap_writes = swap_after.writes - swap_before.writes;
+    result.io_bytes = after.io_bytes - before.io_bytes;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    long accesses = argc > 1 ? atol(argv[1]) : 100000;
+    long footprint = argc > 2 ? atol(argv[2]) : 4 << 20;
+    bool json = argc > 3 && strcmp(argv[3], "json") == 0;
+    pattern_kind only = SEQUENTIAL_PATTERN;
+    bool one_pattern = argc > 4 && parse_pattern(argv[4], &only);
+
+    const long page_sizes[] = {256, 4096};
+    const long memory_fractions[] = {16, 4}; // memory is footprint / fraction
+
+    const char* exec_name = "bench_patterns_exec";
+    const char* swap_name = "bench_patterns_swap";
+    FILE* f = fopen(exec_name, "w");
+    fputs("text", f);
+    fclose(f);
+
+    if(!json)
+        printf("pattern,page_size,memory,footprint,accesses,ns_per_access,fault_rate,major_faults,"
+               "swap_reads,swap_writes,io_bytes\n");
+    for (pattern_kind kind : all_patterns) {
+        if(one_pattern && kind != only)
+            continue;
+        for (long page_size : page_sizes) {
+            for (long fraction : memory_fractions) {
+                long long memory = footprint / fraction;
+                if(memory < page_size)
+                    continue;
+                pattern_result r = run(kind, page_size, memory, footprint, accesses, exec_name, swap_name);
+                double fault_rate = (double)r.faults / accesses;
+                if(json)
+                    printf("{\"pattern\":\"%s\",\"page_size\":%ld,\"memory\":%lld,\"footprint\":%ld,\"accesses\":%ld,"
+                           "\"ns_per_access\":%.2f,\"fault_rate\":%.5f,\"major_faults\":%ld,\"swap_reads\":%ld,"
+                           "\"swap_writes\":%ld,\"io_bytes\":%lld}\n",
+                           pattern_name(kind), page_size, memory, footprint, accesses, r.ns_per_access, fault_rate,
+                           r.major_faults, r.swap_reads, r.swap_writes, r.io_bytes);
+                else
+                    printf("%s,%ld,%lld,%ld,%ld,%.2f,%.5f,%ld,%ld,%ld,%lld\n",
+                           pattern_name(kind), page_size, memory, footprint, accesses, r.ns_per_access, fault_rate,
+                           r.major_faults, r.swap_reads, r.swap_writes, r.io_bytes);
+                fflush(stdout);
+            }
+        }
+    }
+    unlink(swap_name);
+    unlink(exec_name);
+    return 0;
+}
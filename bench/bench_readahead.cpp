@@ -0,0 +1,59 @@
+// exec read-ahead: faults, exec reads and prefetch hits/waste of sequential, strided and uniform
+// loads over a text segment read from the exec file, with read-ahead off and with windows of
+// up to 8 and 32 pages. output is CSV.
+//
+//   bench/bench_readahead [pages] [frames] [page_size]
+#include "sim_mem.h"
+#include "access_patterns.h"
+
+#include <chrono>
+#include <cstdlib>
+
+static volatile char sink;
+
+int main(int argc, char** argv) {
+    long pages = argc > 1 ? atol(argv[1]) : 16384;
+    long frames = argc > 2 ? atol(argv[2]) : 1024;
+    long page_size = argc > 3 ? atol(argv[3]) : 4096;
+
+    const char* exec_name = "bench_readahead_exec";
+    const char* swap_name = "bench_readahead_swap";
+    FILE* f = fopen(exec_name, "w");
+    for (long i = 0; i < pages * page_size; i++)
+        fputc('a' + i % 26, f);
+    fclose(f);
+
+    printf("pattern,readahead_max,accesses,ns_per_access,faults,exec_reads,prefetched,prefetch_hits,prefetch_waste\n");
+    const pattern_kind kinds[] = {SEQUENTIAL_PATTERN, STRIDED_PATTERN, UNIFORM_PATTERN};
+    const int windows[] = {0, 8, 32};
+    for (pattern_kind kind : kinds) {
+        for (int window : windows) {
+            sim_config config;
+            config.memory_size = frames * page_size;
+            config.address_size = 40;
+            config.readahead_max = window;
+            sim_mem mem(exec_name, swap_name, (int)(pages * page_size), 0, 0, 0, (int)page_size, config);
+
+            pattern_params params;
+            params.stride = page_size; // one access per page, every one a fault without read-ahead
+            access_pattern pattern(kind, params, page_size, pages, 7);
+            // the sequential scan touches every byte, the others one byte per page of the text
+            long accesses = kind == SEQUENTIAL_PATTERN ? pages * page_size : pages;
+            char checksum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (long i = 0; i < accesses; i++)
+                checksum ^= mem.load(pattern.next());
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            sink = checksum;
+
+            segment_stats text = mem.stats().segments[TEXT_SEGMENT];
+            printf("%s,%d,%ld,%.2f,%ld,%ld,%ld,%ld,%ld\n", pattern_name(kind), window, accesses, ns / accesses,
+                   text.major_faults + text.minor_faults, text.exec_reads, text.prefetched, text.prefetch_hits,
+                   text.prefetch_waste);
+            fflush(stdout);
+        }
+    }
+    unlink(swap_name);
+    unlink(exec_name);
+    return 0;
+}
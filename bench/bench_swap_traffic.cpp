@@ -0,0 +1,53 @@
+// swap traffic on traces with different read ratios. the heap is several times larger than
+// memory, so pages keep cycling through the swap; clean pages evicted after a swap-in should
+// cost no write.
+//
+//   bench/bench_swap_traffic [pages] [frames] [accesses]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    int pages = argc > 1 ? atoi(argv[1]) : 256;
+    int frames = argc > 2 ? atoi(argv[2]) : 64;
+    int accesses = argc > 3 ? atoi(argv[3]) : 200000;
+    const int page_size = 256;
+
+    const char* exec_name = "bench_swap_traffic_exec";
+    FILE* f = fopen(exec_name, "w");
+    fputs("text", f);
+    fclose(f);
+
+    printf("pages=%d frames=%d accesses=%d\n", pages, frames, accesses);
+    printf("%-8s %14s %14s %12s\n", "reads%", "swap writes/1k", "swap reads/1k", "ns/access");
+    const int read_percent[] = {50, 90, 99};
+    for (int r : read_percent) {
+        sim_config config;
+        config.memory_size = (long long)frames * page_size;
+        config.address_size = 32;
+        sim_mem mem(exec_name, "bench_swap_traffic_swap", 0, 0, 0, pages * page_size, page_size, config);
+        uint64_t heap = 3ULL << 30;
+        for (int p = 0; p < pages; p++)
+            mem.store(heap + (uint64_t)p * page_size, 'h');
+        swap_usage before = mem.swap_slot_usage();
+
+        srand(r);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < accesses; i++) {
+            uint64_t address = heap + (uint64_t)(rand() % pages) * page_size + rand() % page_size;
+            if(rand() % 100 < r)
+                mem.load(address);
+            else
+                mem.store(address, 'w');
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        swap_usage after = mem.swap_slot_usage();
+        printf("%-8d %14.1f %14.1f %12.1f\n", r,
+               1000.0 * (after.writes - before.writes) / accesses,
+               1000.0 * (after.reads - before.reads) / accesses, ns / accesses);
+    }
+    unlink("bench_swap_traffic_swap");
+    unlink(exec_name);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// scaling of concurrent mode: 1..N threads doing uniform loads and stores on one sim_mem, once
+// with a heap that fits in memory (all hits, the striped locks) and once with a heap four
+// times larger (faults, the sharded CLOCK and the frame pool). the single threaded mode is
+// printed first as the baseline. output is CSV.
+//
+// first it checks the frame pool (atomic_bitmap_allocator): the threads allocate and release
+// runs of indexes at once, and whenever they have all stopped, draining the pool must hand out
+// every index. an index whose bit is set behind the pool's first-word hint would be lost to
+// allocate() while available() still counts it. exits with 1 if that happens.
+//
+//   bench/bench_threads [max_threads] [accesses_per_thread]
+#include "sim_mem.h"
+#include "access_patterns.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static const int page_size = 256;
+static const long frames = 1024;
+
+// rounds of threads hammering a small pool, the runs straddle its word boundaries
+static bool check_frame_pool(int threads, int rounds) {
+    const int size = 256;
+    atomic_bitmap_allocator pool(size);
+    for (int round = 0; round < rounds; round++) {
+        auto worker = [&](int id) {
+            int taken[48];
+            unsigned seed = round * threads + id + 1;
+            for (int i = 0; i < 2000; i++) {
+                int count = 1 + rand_r(&seed) % 48;
+                int got = 0;
+                while (got < count && (taken[got] = pool.allocate()) != -1)
+                    got++;
+                for (int t = 0; t < got; t++)
+                    pool.release(taken[t]);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+            workers.emplace_back(worker, t);
+        for (std::thread& t : workers)
+            t.join();
+        // nothing else allocates now, every free index must come out
+        int available = pool.available(), drained = 0;
+        std::vector<int> taken;
+        for (int index; (index = pool.allocate()) != -1; drained++)
+            taken.push_back(index);
+        if(available != size || drained != size) {
+            printf("# frame pool: round %d, %d available but %d allocated of %d\n", round, available, drained, size);
+            return false;
+        }
+        for (int index : taken)
+            pool.release(index);
+    }
+    printf("# frame pool: %d rounds on %d threads, no free index lost\n", rounds, threads);
+    return true;
+}
+
+static double run(bool concurrent, int threads, long pages, long accesses, long* faults) {
+    sim_config config;
+    config.memory_size = frames * page_size;
+    config.address_size = 32;
+    config.concurrent = concurrent;
+    sim_mem mem("bench_threads_exec", "bench_threads_swap", 0, 0, 0, pages * page_size, page_size, config);
+    uint64_t heap = 3ULL << 30;
+    for (long p = 0; p < pages; p++)
+        mem.store(heap + (uint64_t)p * page_size, 'h');
+    segment_stats before = mem.stats().total();
+
+    auto worker = [&](int id) {
+        pattern_params params;
+        params.write_ratio = 0.2;
+        access_pattern pattern(UNIFORM_PATTERN, params, page_size, pages, id + 1);
+        for (long i = 0; i < accesses; i++) {
+            uint64_t address = heap + pattern.next();
+            if(pattern.next_is_store())
+                mem.store(address, (char)i);
+            else
+                mem.load(address);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back(worker, t);
+    for (std::thread& t : workers)
+        t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    segment_stats after = mem.stats().total();
+    *faults = after.major_faults + after.minor_faults - before.major_faults - before.minor_faults;
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+    int hardware = (int)std::thread::hardware_concurrency();
+    int max_threads = argc > 1 ? atoi(argv[1]) : (hardware > 8 ? hardware : 8);
+    long accesses = argc > 2 ? atol(argv[2]) : 200000;
+
+    FILE* f = fopen("bench_threads_exec", "w");
+    fputs("text", f);
+    fclose(f);
+
+    printf("# %d hardware threads\n", hardware);
+    if(!check_frame_pool(max_threads, 200))
+        return 1;
+    printf("workload,mode,threads,accesses,seconds,accesses_per_sec,speedup,faults\n");
+    const char* workloads[] = {"hits", "faults"};
+    const long heap_pages[] = {frames, frames * 4};
+    for (int w = 0; w < 2; w++) {
+        long faults;
+        double seconds = run(false, 1, heap_pages[w], accesses, &faults);
+        printf("%s,single,1,%ld,%.3f,%.0f,,%ld\n", workloads[w], accesses, seconds, accesses / seconds, faults);
+        double base = 0;
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            seconds = run(true, threads, heap_pages[w], accesses, &faults);
+            double rate = threads * accesses / seconds;
+            if(threads == 1)
+                base = rate;
+            printf("%s,concurrent,%d,%ld,%.3f,%.0f,%.2f,%ld\n", workloads[w], threads, threads * accesses, seconds,
+                   rate, rate / base, faults);
+            fflush(stdout);
+            if(threads < max_threads && threads * 2 > max_threads)
+                threads = max_threads / 2; // finish on max_threads itself
+        }
+    }
+    unlink("bench_threads_swap");
+    unlink("bench_threads_exec");
+    return 0;
+}
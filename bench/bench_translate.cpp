@@ -0,0 +1,95 @@
+// measures the cost of address translation per access: the old bitset/string parseAddress
+// against the precomputed shift/mask translator, and a full sim_mem::load hit on top of it,
+// with and without the software TLB.
+//
+//   bench/bench_translate [exec_file] [iterations]
+#include "sim_mem.h"
+
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// the translation sim_mem used before, kept here as the baseline
+static void legacy_parse_address(int address, int size, int* offset, int* in, int* out)
+{
+    bitset<ADDRESS_SIZE> binaryNumber(address);
+    string binary = binaryNumber.to_string();
+
+    bitset<ADDRESS_SIZE> BinaryIn(binary.substr(0, 2));
+    *out = BinaryIn.to_ulong();
+
+    int log2result = log(size) / log(2);
+
+    bitset<ADDRESS_SIZE> BinaryOffset(binary.substr(12-log2result, ADDRESS_SIZE));
+    *offset = BinaryOffset.to_ulong() % size;
+
+    bitset<ADDRESS_SIZE> BinaryOut(binary.substr(2, 12));
+    *in = BinaryOut.to_ulong() / size;
+}
+
+static double now_ns() {
+    return std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    const char* exec_file = argc > 1 ? argv[1] : "exec_file";
+    int iterations = argc > 2 ? atoi(argv[2]) : 5000000;
+    const int page_size = 4;
+
+    std::vector<int> addresses(1 << 16);
+    srand(1);
+    for (int& a : addresses)
+        a = rand() & ((1 << ADDRESS_SIZE) - 1);
+    int mask = (int)addresses.size() - 1;
+
+    long checksum = 0;
+    int offset, in, out;
+
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        legacy_parse_address(addresses[i & mask], page_size, &offset, &in, &out);
+        checksum += offset + in + out;
+    }
+    double legacy = (now_ns() - start) / iterations;
+
+    address_translator translator;
+    translator.init(page_size, ADDRESS_SIZE, 2);
+    uint64_t page;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        translator.translate(addresses[i & mask], &offset, &page, &out);
+        checksum += offset + page + out;
+    }
+    double shifted = (now_ns() - start) / iterations;
+
+    // the four DATA pages fill memory, every load after the first pass is a hit, with the
+    // software TLB and with the page table walk it replaces
+    auto load_hits = [&](int tlb_entries, tlb_usage* usage) {
+        sim_config config;
+        config.tlb_entries = tlb_entries;
+        sim_mem mem(exec_file, "bench_translate_swap", 16, 16, 16, 16, page_size, config);
+        int data_address = 1 << (ADDRESS_SIZE - 2);
+        for (int i = 0; i < 16; i += page_size)
+            mem.load(data_address + i);
+        double begin = now_ns();
+        for (int i = 0; i < iterations; i++)
+            checksum += mem.load(data_address + (i & 15));
+        double elapsed = (now_ns() - begin) / iterations;
+        *usage = mem.tlb_stats();
+        unlink("bench_translate_swap");
+        return elapsed;
+    };
+    tlb_usage tlb_on, tlb_off;
+    double hit = load_hits(64, &tlb_on);
+    double walk = load_hits(0, &tlb_off);
+
+    printf("translation (bitset/string): %8.2f ns/access\n", legacy);
+    printf("translation (shift/mask):    %8.2f ns/access\n", shifted);
+    printf("sim_mem::load hit (TLB):     %8.2f ns/access  (%ld TLB hits, %ld misses)\n", hit, tlb_on.hits, tlb_on.misses);
+    printf("sim_mem::load hit (no TLB):  %8.2f ns/access\n", walk);
+    printf("checksum %ld\n", checksum);
+    return 0;
+}
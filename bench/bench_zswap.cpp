@@ -0,0 +1,75 @@
+// compressed swap pool: disk traffic and access cost without the pool, with a budget of 1/16 of
+// the heap and with one that holds all of it. the heap is four times memory, a third of its pages
+// hold text, a third are blank ('0'-filled, the pool's same-filled case) and a third random
+// bytes that don't compress. output is CSV.
+//
+//   bench/bench_zswap [pages] [frames] [accesses] [page_size]
+#include "sim_mem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char** argv) {
+    int pages = argc > 1 ? atoi(argv[1]) : 1024;
+    int frames = argc > 2 ? atoi(argv[2]) : 256;
+    int accesses = argc > 3 ? atoi(argv[3]) : 200000;
+    int page_size = argc > 4 ? atoi(argv[4]) : 4096;
+
+    const char* exec_name = "bench_zswap_exec";
+    const char* swap_name = "bench_zswap_swap";
+    FILE* f = fopen(exec_name, "w");
+    fputs("text", f);
+    fclose(f);
+
+    const char* words[] = {"page ", "frame ", "swap ", "fault ", "memory ", "the ", "of ", "evict "};
+    std::vector<char> content(page_size);
+
+    printf("budget,swap_writes_per_1k,swap_reads_per_1k,pool_hit_rate,ratio,same_filled,spills,ns_per_access\n");
+    const long long budgets[] = {0, (long long)pages * page_size / 16, (long long)pages * page_size};
+    for (long long budget : budgets) {
+        sim_config config;
+        config.memory_size = (long long)frames * page_size;
+        config.address_size = 40;
+        config.zswap_budget = budget;
+        sim_mem mem(exec_name, swap_name, 0, 0, 0, pages * page_size, page_size, config);
+        uint64_t heap = (uint64_t)HEAP_STACK_SEGMENT << 38;
+        srand(5);
+        for (int p = 0; p < pages; p++) {
+            for (int i = 0; i < page_size; ) {
+                if(p % 3 == 0) {
+                    for (const char* w = words[rand() % 8]; *w != '\0' && i < page_size; w++)
+                        content[i++] = *w;
+                }
+                else {
+                    content[i++] = p % 3 == 1 ? '0' : (char)rand();
+                }
+            }
+            mem.store_range(heap + (uint64_t)p * page_size, content.data(), page_size);
+        }
+        swap_usage before = mem.swap_slot_usage();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < accesses; i++) {
+            int page = rand() % pages;
+            uint64_t address = heap + (uint64_t)page * page_size + rand() % page_size;
+            // stores keep each page's kind of content
+            if(rand() % 10 < 8)
+                mem.load(address);
+            else
+                mem.store(address, page % 3 == 1 ? '0' : 'w');
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        swap_usage after = mem.swap_slot_usage();
+        zswap_usage pool = mem.zswap_stats();
+        printf("%lld,%.1f,%.1f,%.3f,%.2f,%d,%ld,%.1f\n", budget,
+               1000.0 * (after.writes - before.writes) / accesses,
+               1000.0 * (after.reads - before.reads) / accesses,
+               pool.loads == 0 ? 0.0 : (double)pool.hits / pool.loads, pool.ratio, pool.same_filled_pages,
+               pool.spills, ns / accesses);
+        fflush(stdout);
+    }
+    unlink(swap_name);
+    unlink(exec_name);
+    return 0;
+}
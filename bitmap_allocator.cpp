@@ -0,0 +1,94 @@
+#include "bitmap_allocator.h"
+
+bitmap_allocator::bitmap_allocator(int size)
+    : words((size + 63) / 64, ~0ULL), size(size), free_count(size), first_word(0) {
+    // the bits past the end of the last word don't exist, they must never look free
+    if(size % 64 != 0)
+        words.back() = (1ULL << (size % 64)) - 1;
+}
+
+int bitmap_allocator::allocate_aligned(int count) {
+    int num_words = (int)words.size();
+    if(count >= 64) { // whole words, count / 64 of them starting at a multiple of that
+        int span = count / 64;
+        for (int word = first_word / span * span; word + span <= num_words; word += span) {
+            int full = 0;
+            while (full < span && words[word + full] == ~0ULL)
+                full++;
+            if(full == span) {
+                take(word * 64, count);
+                return word * 64;
+            }
+        }
+        return -1;
+    }
+    uint64_t aligned = 0; // the bits a run may start at
+    for (int bit = 0; bit < 64; bit += count)
+        aligned |= 1ULL << bit;
+    for (int word = first_word; word < num_words; word++) {
+        // a bit stays set where it and the count - 1 bits above it are all free
+        uint64_t runs = words[word];
+        for (int width = 1; width < count; width <<= 1)
+            runs &= runs >> width;
+        runs &= aligned;
+        if(runs != 0) {
+            int index = word * 64 + __builtin_ctzll(runs);
+            take(index, count);
+            return index;
+        }
+    }
+    return -1;
+}
+
+int bitmap_allocator::allocate_run(int count) {
+    int run = 0;
+    for (int word = first_word; word < (int)words.size(); word++) {
+        uint64_t bits = words[word];
+        if(bits == 0) {
+            run = 0;
+            continue;
+        }
+        if(bits == ~0ULL && run + 64 < count) {
+            run += 64;
+            continue;
+        }
+        for (int bit = 0; bit < 64; bit++) {
+            if(((bits >> bit) & 1) == 0) {
+                run = 0;
+                continue;
+            }
+            if(++run == count) {
+                int first = word * 64 + bit - count + 1;
+                take(first, count);
+                return first;
+            }
+        }
+    }
+    return -1;
+}
+
+int bitmap_allocator::free_runs(int* longest) const {
+    int runs = 0, run = 0;
+    *longest = 0;
+    for (int i = 0; i < size; i++) {
+        if(is_free(i)) {
+            if(run == 0)
+                runs++;
+            run++;
+            if(run > *longest)
+                *longest = run;
+        }
+        else {
+            run = 0;
+        }
+    }
+    return runs;
+}
+
+atomic_bitmap_allocator::atomic_bitmap_allocator(int size)
+    : words((size + 63) / 64), size(size), first_word(0), free_count(size) {
+    for (std::atomic<uint64_t>& word : words)
+        word.store(~0ULL, std::memory_order_relaxed);
+    if(size % 64 != 0)
+        words.back().store((1ULL << (size % 64)) - 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,136 @@
+#ifndef OS_EX4_BITMAP_ALLOCATOR_H
+#define OS_EX4_BITMAP_ALLOCATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// hands out the lowest free index in [0, size). a set bit means free, so finding one is a
+// find-first-set on the first non-zero word. first_word never points past a free index,
+// which makes allocation O(1) in the common case and O(size/64) at worst.
+class bitmap_allocator {
+    std::vector<uint64_t> words;
+    int size;
+    int free_count;
+    int first_word;
+
+    void take(int first, int count) {
+        for (int index = first; index < first + count; index++)
+            words[index / 64] &= ~(1ULL << (index % 64));
+        free_count -= count;
+    }
+
+public:
+    explicit bitmap_allocator(int size);
+
+    // returns the lowest free index and marks it used, -1 if everything is taken
+    int allocate() {
+        int num_words = (int)words.size();
+        while (first_word < num_words && words[first_word] == 0)
+            first_word++;
+        if(first_word == num_words)
+            return -1;
+        int index = first_word * 64 + __builtin_ctzll(words[first_word]);
+        words[first_word] &= words[first_word] - 1; // clear the lowest set bit
+        free_count--;
+        return index;
+    }
+
+    // returns the lowest free index at or after start, wrapping around to the beginning,
+    // -1 if everything is taken
+    int allocate_from(int start) {
+        int num_words = (int)words.size();
+        if(start <= 0 || start >= size)
+            return allocate();
+        int word = start / 64;
+        uint64_t bits = words[word] & (~0ULL << (start % 64));
+        while (bits == 0 && ++word < num_words)
+            bits = words[word];
+        if(bits == 0)
+            return allocate();
+        int index = word * 64 + __builtin_ctzll(bits);
+        words[word] &= ~(1ULL << (index % 64));
+        free_count--;
+        return index;
+    }
+
+    // the lowest free run of count indexes starting at a multiple of count, a power of two, all
+    // marked used. -1 if there is none
+    int allocate_aligned(int count);
+    // the lowest free run of count indexes wherever it starts, all marked used. -1 if there is none
+    int allocate_run(int count);
+
+    // gives an index back
+    void release(int index) {
+        int word = index / 64;
+        words[word] |= 1ULL << (index % 64);
+        free_count++;
+        if(word < first_word)
+            first_word = word;
+    }
+
+    // marks a given free index used, when a bitmap is rebuilt. false if it was taken already
+    bool claim(int index) {
+        if(!is_free(index))
+            return false;
+        words[index / 64] &= ~(1ULL << (index % 64));
+        free_count--;
+        return true;
+    }
+    bool is_free(int index) const { return (words[index / 64] >> (index % 64)) & 1; }
+    int capacity() const { return size; }
+    int available() const { return free_count; }
+    // number of maximal runs of free indexes, and the length of the longest one
+    int free_runs(int* longest) const;
+};
+
+// the same bitmap for several threads at once: a word's lowest set bit is taken with a
+// compare-and-swap and released with an atomic or, nothing ever blocks
+class atomic_bitmap_allocator {
+    std::vector<std::atomic<uint64_t>> words;
+    int size;
+    std::atomic<int> first_word; // a hint, every word before it is empty once allocators settle
+    std::atomic<int> free_count;
+
+public:
+    explicit atomic_bitmap_allocator(int size);
+
+    // returns a free index and marks it used, -1 if everything looked taken
+    int allocate() {
+        int num_words = (int)words.size();
+        for (int word = first_word.load(std::memory_order_relaxed); word < num_words; word++) {
+            uint64_t bits = words[word].load(std::memory_order_relaxed);
+            while (bits != 0) {
+                if(words[word].compare_exchange_weak(bits, bits & (bits - 1), std::memory_order_acquire)) {
+                    free_count.fetch_sub(1, std::memory_order_relaxed);
+                    return word * 64 + __builtin_ctzll(bits);
+                }
+            }
+            // a release into this word may have read the hint before the move past it. seq_cst
+            // on both sides means one of them sees the other: either the release lowers the
+            // hint, or the word is found non-empty here and the hint goes back
+            int expected = word;
+            if(first_word.compare_exchange_strong(expected, word + 1, std::memory_order_seq_cst) &&
+               words[word].load(std::memory_order_seq_cst) != 0) {
+                int hint = word + 1;
+                while (hint > word && !first_word.compare_exchange_weak(hint, word, std::memory_order_seq_cst)) {}
+                word--; // and try it again
+            }
+        }
+        return -1;
+    }
+
+    void release(int index) {
+        int word = index / 64;
+        words[word].fetch_or(1ULL << (index % 64), std::memory_order_seq_cst);
+        free_count.fetch_add(1, std::memory_order_relaxed);
+        int hint = first_word.load(std::memory_order_seq_cst);
+        while (word < hint && !first_word.compare_exchange_weak(hint, word, std::memory_order_seq_cst)) {}
+    }
+
+    int capacity() const { return size; }
+    // free indexes, only a snapshot while other threads allocate and release
+    int available() const { return free_count.load(std::memory_order_relaxed); }
+};
+
+#endif //OS_EX4_BITMAP_ALLOCATOR_H
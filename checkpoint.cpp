@@ -0,0 +1,359 @@
+#include "checkpoint.h"
+#include "sim_mem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// dst becomes a copy of src's first length bytes: a reflink sharing src's blocks where the
+// filesystem supports it, copy_file_range or a read/write loop otherwise
+static bool copy_file(int src, int dst, off_t length)
+{
+    if(ioctl(dst, FICLONE, src) == 0)
+        return true;
+    if(ftruncate(dst, length) == -1)
+        return false;
+    off_t in = 0, out = 0;
+    while (in < length) {
+        ssize_t copied = copy_file_range(src, &in, dst, &out, length - in, 0);
+        if(copied <= 0)
+            break;
+    }
+    std::vector<char> buffer(1 << 20);
+    while (in < length) {
+        ssize_t got = pread(src, buffer.data(), std::min<off_t>(length - in, buffer.size()), in);
+        if(got <= 0 || pwrite(dst, buffer.data(), got, in) != got)
+            return false;
+        in += got;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* data, size_t length, off_t offset)
+{
+    const char* next = (const char*)data;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, next, length, offset);
+        if(written <= 0)
+            return false;
+        next += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool default_page(const checkpoint_page& page)
+{
+    return page.flags == 0 && page.frame == -1 && page.swap_index == -1;
+}
+
+// writes the simulator's state to path and a copy of its swap file to path.swap. the statistics
+// aren't saved, a simulator keeps its own counters across a restore
+bool sim_mem::save_checkpoint(const char* path)
+{
+    // only a simulator with a private memory, one thread and base pages only is checkpointed
+    if(path == NULL || !owns_memory || concurrent || large_pages)
+    {
+        cout << "ERR" << endl;
+        return false;
+    }
+    if(memory->swap_async != nullptr)
+        memory->swap_async->drain(); // the file has to catch up with the write-back buffer
+
+    std::string swap_path = std::string(path) + ".swap";
+    int swap_copy = open(swap_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    struct stat st;
+    if(swap_copy == -1 || fstat(memory->swap_file.descriptor(), &st) == -1 ||
+       !copy_file(memory->swap_file.descriptor(), swap_copy, st.st_size))
+    {
+        perror("ERR");
+        if(swap_copy != -1)
+            close(swap_copy);
+        return false;
+    }
+    // the compressed pool's pages are newer than the file's copies
+    if(memory->zswap != nullptr) {
+        std::vector<char> page(page_size);
+        for (int slot = 0; slot < memory->swap_slots->capacity(); slot++) {
+            if(memory->zswap->peek(slot, page.data()) &&
+               !write_all(swap_copy, page.data(), page_size, (off_t)slot * page_size))
+            {
+                perror("ERR");
+                close(swap_copy);
+                return false;
+            }
+        }
+    }
+    close(swap_copy);
+
+    checkpoint_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.page_size = page_size;
+    header.num_frames = num_frames;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++)
+        header.seg_pages[seg] = seg_pages[seg];
+    header.swap_slots = memory->swap_slots->capacity();
+    header.policy = policy_kind;
+    header.memory_size = memory->memory_size;
+
+    std::vector<checkpoint_frame> frame_table(num_frames);
+    for (int i = 0; i < num_frames; i++) {
+        frame_table[i].segment = frames[i].segment;
+        frame_table[i].page = frames[i].page;
+        frame_table[i].mappers = frames[i].mappers;
+        frame_table[i].owned = frames[i].owner != nullptr;
+    }
+    // every page, the ones a radix table never allocated as unmapped
+    std::vector<checkpoint_page> pages;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        for (int i = 0; i < seg_pages[seg]; i++) {
+            const page_descriptor* page = page_table.find(seg, i);
+            checkpoint_page saved = {-1, -1, 0};
+            if(page != nullptr) {
+                saved.frame = page->frame;
+                saved.swap_index = page->swap_index;
+                saved.flags = (page->valid ? CHECKPOINT_VALID : 0) | (page->dirty ? CHECKPOINT_DIRTY : 0) |
+                              (page->in_swap ? CHECKPOINT_IN_SWAP : 0) |
+                              (page->prefetched ? CHECKPOINT_PREFETCHED : 0);
+            }
+            pages.push_back(saved);
+        }
+    }
+    state_writer policy_state;
+    policy->save(policy_state);
+    checkpoint_state state;
+    memset(&state, 0, sizeof(state));
+    state.owned_frames = owned_frames;
+    state.resident_pages = resident_pages;
+    state.peak_resident = peak_resident;
+    state.swap_peak = memory->swap_peak;
+    state.swap_reads = memory->swap_reads;
+    state.swap_writes = memory->swap_writes;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        state.readahead[seg][0] = readahead[seg].next;
+        state.readahead[seg][1] = readahead[seg].size;
+        state.readahead[seg][2] = readahead[seg].issued;
+        state.readahead[seg][3] = readahead[seg].used;
+    }
+    state.pageout_countdown = pageout_countdown;
+
+    const void* data[CHECKPOINT_SECTIONS] = {main_memory, frame_table.data(), pages.data(),
+                                             policy_state.bytes.data(), &state};
+    size_t lengths[CHECKPOINT_SECTIONS] = {(size_t)memory->memory_size, frame_table.size() * sizeof(checkpoint_frame),
+                                           pages.size() * sizeof(checkpoint_page), policy_state.bytes.size(),
+                                           sizeof(state)};
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd == -1)
+    {
+        perror("ERR");
+        return false;
+    }
+    off_t offset = CHECKPOINT_ALIGN; // the header has the first block to itself
+    bool ok = true;
+    for (int section = 0; section < CHECKPOINT_SECTIONS && ok; section++) {
+        offset = (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+        header.sections[section].offset = offset;
+        header.sections[section].length = lengths[section];
+        ok = write_all(fd, data[section], lengths[section], offset);
+        offset += lengths[section];
+    }
+    // the header goes last, a checkpoint cut short has no valid one
+    ok = ok && write_all(fd, &header, sizeof(header), 0);
+    if(close(fd) == -1 || !ok)
+    {
+        perror("ERR");
+        return false;
+    }
+    return true;
+}
+
+// puts the simulator back in the state save_checkpoint wrote to path, which has to come from a
+// simulator built the same way (page size, segments, memory, swap and policy). false, with
+// nothing changed, when it doesn't
+bool sim_mem::restore_checkpoint(const char* path)
+{
+    if(path == NULL || !owns_memory || concurrent || large_pages)
+    {
+        cout << "ERR" << endl;
+        return false;
+    }
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(checkpoint_header))
+    {
+        cout << "ERR" << endl;
+        if(fd != -1)
+            close(fd);
+        return false;
+    }
+    // the sections are read in place from the mapping
+    char* file = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(file == MAP_FAILED)
+    {
+        perror("ERR");
+        return false;
+    }
+    checkpoint_header header;
+    memcpy(&header, file, sizeof(header));
+
+    int total_pages = 0;
+    bool same_layout = true;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        same_layout = same_layout && header.seg_pages[seg] == seg_pages[seg];
+        total_pages += seg_pages[seg];
+    }
+    size_t lengths[CHECKPOINT_SECTIONS] = {(size_t)memory->memory_size, num_frames * sizeof(checkpoint_frame),
+                                           total_pages * sizeof(checkpoint_page), 0, sizeof(checkpoint_state)};
+    bool ok = memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CHECKPOINT_VERSION && header.byte_order == CHECKPOINT_BYTE_ORDER &&
+              header.page_size == page_size && header.num_frames == num_frames && same_layout &&
+              header.swap_slots == memory->swap_slots->capacity() && header.policy == policy_kind &&
+              header.memory_size == memory->memory_size;
+    for (int section = 0; section < CHECKPOINT_SECTIONS && ok; section++) {
+        checkpoint_extent extent = header.sections[section];
+        ok = extent.offset <= (uint64_t)st.st_size && extent.length <= (uint64_t)st.st_size - extent.offset &&
+             (section == CHECKPOINT_POLICY || extent.length == lengths[section]);
+    }
+
+    const checkpoint_frame* frame_table = nullptr;
+    const checkpoint_page* pages = nullptr;
+    bitmap_allocator* free_frames = nullptr;
+    bitmap_allocator* swap_slots = nullptr;
+    replacement_policy* restored = nullptr;
+    if(ok) {
+        frame_table = (const checkpoint_frame*)(file + header.sections[CHECKPOINT_FRAMES].offset);
+        pages = (const checkpoint_page*)(file + header.sections[CHECKPOINT_PAGE_TABLE].offset);
+        // the allocators are rebuilt from the frames and the pages, every page's frame and slot
+        // has to be in range and its own
+        free_frames = new bitmap_allocator(num_frames);
+        for (int i = 0; i < num_frames && ok; i++) {
+            if(frame_table[i].owned)
+                free_frames->claim(i);
+        }
+        swap_slots = new bitmap_allocator(memory->swap_slots->capacity());
+        for (int i = 0; i < total_pages && ok; i++) {
+            const checkpoint_page &page = pages[i];
+            if(page.flags & CHECKPOINT_VALID)
+                ok = page.frame >= 0 && page.frame < num_frames && frame_table[page.frame].owned;
+            if(ok && (page.flags & CHECKPOINT_IN_SWAP))
+                ok = page.swap_index >= 0 && page.swap_index < swap_slots->capacity() &&
+                     swap_slots->claim(page.swap_index);
+        }
+        restored = make_policy(policy_kind, num_frames, memory->next_key);
+        state_reader policy_state(file + header.sections[CHECKPOINT_POLICY].offset,
+                                  header.sections[CHECKPOINT_POLICY].length);
+        ok = ok && restored != nullptr && restored->restore(policy_state);
+    }
+    // the swap copy has to match the live file's length
+    std::string swap_path = std::string(path) + ".swap";
+    int swap_copy = -1;
+    struct stat swap_st, live_st;
+    if(ok) {
+        swap_copy = open(swap_path.c_str(), O_RDONLY);
+        ok = swap_copy != -1 && fstat(swap_copy, &swap_st) == 0 &&
+             fstat(memory->swap_file.descriptor(), &live_st) == 0 && swap_st.st_size == live_st.st_size;
+    }
+    if(!ok)
+    {
+        cout << "ERR" << endl;
+        if(swap_copy != -1)
+            close(swap_copy);
+        delete free_frames;
+        delete swap_slots;
+        delete restored;
+        munmap(file, st.st_size);
+        return false;
+    }
+
+    // from here on the simulator is overwritten, failing halfway would leave it inconsistent
+    if(memory->swap_async != nullptr)
+        memory->swap_async->drain(); // nothing buffered may land on the restored file later
+    bool copied;
+    if(memory->swap_file.mapped()) {
+        // written through the mapping, which stays valid
+        std::vector<char> buffer(1 << 20);
+        copied = true;
+        for (off_t done = 0; done < swap_st.st_size && copied; ) {
+            ssize_t got = pread(swap_copy, buffer.data(), std::min<off_t>(swap_st.st_size - done, buffer.size()), done);
+            copied = got > 0 && memory->swap_file.write(buffer.data(), done, got) == got;
+            done += got;
+        }
+    }
+    else {
+        copied = copy_file(swap_copy, memory->swap_file.descriptor(), swap_st.st_size);
+    }
+    close(swap_copy);
+    if(!copied)
+    {
+        perror("ERR");
+        exit(1);
+    }
+
+    memcpy(main_memory, file + header.sections[CHECKPOINT_MEMORY].offset, memory->memory_size);
+    for (int i = 0; i < num_frames; i++) {
+        frames[i].owner = frame_table[i].owned ? this : nullptr;
+        frames[i].segment = frame_table[i].segment;
+        frames[i].page = frame_table[i].page;
+        frames[i].mappers = frame_table[i].mappers;
+    }
+    const checkpoint_page* next = pages;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        for (int i = 0; i < seg_pages[seg]; i++, next++) {
+            // a radix table only allocates the pages that aren't unmapped on both sides
+            if(default_page(*next) && page_table.find(seg, i) == nullptr)
+                continue;
+            page_descriptor &page = page_table[seg][i];
+            page.valid = (next->flags & CHECKPOINT_VALID) != 0;
+            page.dirty = (next->flags & CHECKPOINT_DIRTY) != 0;
+            page.in_swap = (next->flags & CHECKPOINT_IN_SWAP) != 0;
+            page.prefetched = (next->flags & CHECKPOINT_PREFETCHED) != 0;
+            page.frame = next->frame;
+            page.swap_index = next->swap_index;
+        }
+    }
+    delete memory->free_frames;
+    memory->free_frames = free_frames;
+    delete memory->swap_slots;
+    memory->swap_slots = swap_slots;
+    if(memory->policy == policy)
+        memory->policy = restored;
+    delete policy;
+    policy = restored;
+
+    checkpoint_state state;
+    memcpy(&state, file + header.sections[CHECKPOINT_STATE].offset, sizeof(state));
+    owned_frames = state.owned_frames;
+    resident_pages = state.resident_pages;
+    peak_resident = state.peak_resident;
+    memory->swap_peak = state.swap_peak;
+    memory->swap_reads = state.swap_reads;
+    memory->swap_writes = state.swap_writes;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        readahead[seg].next = state.readahead[seg][0];
+        readahead[seg].size = state.readahead[seg][1];
+        readahead[seg].issued = state.readahead[seg][2];
+        readahead[seg].used = state.readahead[seg][3];
+    }
+    // the daemon runs where it would have, as long as this simulator has it too
+    if(pageout_low > 0)
+        pageout_countdown = std::max<int64_t>(1, std::min<int64_t>(state.pageout_countdown, pageout_interval));
+    // the swap file has every page now, the pool starts over empty
+    if(memory->zswap != nullptr) {
+        long long budget = memory->zswap->usage().budget;
+        delete memory->zswap;
+        memory->zswap = new compressed_swap(page_size, swap_slots->capacity(), budget);
+    }
+    if(tlb_shift >= 0)
+        tlb.flush();
+    munmap(file, st.st_size);
+    return true;
+}
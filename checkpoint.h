@@ -0,0 +1,127 @@
+#ifndef OS_EX4_CHECKPOINT_H
+#define OS_EX4_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// a checkpoint is a header followed by sections, each starting on a CHECKPOINT_ALIGN boundary
+// so a reader can map the file and use the frame contents in place. integers are fixed width in
+// the byte order of the machine that wrote them, byte_order tells a reader which one that was.
+// the swap file is saved next to it as <path>.swap. a checkpoint is trusted input: the header
+// is checked, the policy state isn't
+#define CHECKPOINT_MAGIC "SIMCKPT"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_ALIGN 4096
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+
+enum checkpoint_section {
+    CHECKPOINT_MEMORY,     // the frames' bytes, memory_size of them
+    CHECKPOINT_FRAMES,     // a checkpoint_frame per frame
+    CHECKPOINT_PAGE_TABLE, // a checkpoint_page per page, segment after segment
+    CHECKPOINT_POLICY,     // the replacement policy's own state
+    CHECKPOINT_STATE,      // a checkpoint_state
+    CHECKPOINT_SECTIONS
+};
+
+typedef struct checkpoint_extent {
+    uint64_t offset;
+    uint64_t length;
+} checkpoint_extent;
+
+typedef struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // the machine, a checkpoint only restores into one built the same way
+    int32_t page_size;
+    int32_t num_frames;
+    int32_t seg_pages[4];
+    int32_t swap_slots;
+    int32_t policy;
+    int64_t memory_size;
+    checkpoint_extent sections[CHECKPOINT_SECTIONS];
+} checkpoint_header;
+
+typedef struct checkpoint_frame {
+    int32_t segment;  // -1 while free
+    int32_t page;
+    int32_t mappers;
+    int32_t owned;
+} checkpoint_frame;
+
+#define CHECKPOINT_VALID 1
+#define CHECKPOINT_DIRTY 2
+#define CHECKPOINT_IN_SWAP 4
+#define CHECKPOINT_PREFETCHED 8
+
+typedef struct checkpoint_page {
+    int32_t frame;
+    int32_t swap_index;
+    uint32_t flags;
+} checkpoint_page;
+
+typedef struct checkpoint_state {
+    int32_t owned_frames;
+    int32_t resident_pages;
+    int32_t peak_resident;
+    int32_t swap_peak;
+    int64_t swap_reads;
+    int64_t swap_writes;
+    int32_t readahead[4][4]; // next, size, issued and used of each segment's window
+    int64_t pageout_countdown; // accesses until the page-out daemon's next run
+} checkpoint_state;
+
+// serializes plain values and vectors of them, in native byte order
+struct state_writer {
+    std::vector<char> bytes;
+
+    template <class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values are written");
+        const char* p = (const char*)&value;
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+    template <class T>
+    void put(const std::vector<T>& values) {
+        put((uint64_t)values.size());
+        const char* p = (const char*)values.data();
+        bytes.insert(bytes.end(), p, p + values.size() * sizeof(T));
+    }
+};
+
+// reads back what state_writer wrote, ok turns false at the first read past the end
+struct state_reader {
+    const char* next;
+    const char* end;
+    bool ok;
+
+    state_reader(const char* data, size_t size) : next(data), end(data + size), ok(true) {}
+
+    template <class T>
+    void get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values are read");
+        if(!ok || (size_t)(end - next) < sizeof(T)) {
+            ok = false;
+            return;
+        }
+        memcpy(&value, next, sizeof(T));
+        next += sizeof(T);
+    }
+    template <class T>
+    void get(std::vector<T>& values) {
+        uint64_t size = 0;
+        get(size);
+        if(!ok || size > (uint64_t)(end - next) / sizeof(T)) {
+            ok = false;
+            return;
+        }
+        values.resize(size);
+        memcpy((void*)values.data(), next, size * sizeof(T));
+        next += size * sizeof(T);
+    }
+};
+
+#endif //OS_EX4_CHECKPOINT_H
@@ -0,0 +1,146 @@
+#include "compressed_swap.h"
+#include "lz_codec.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+compressed_swap::compressed_swap(int page_size, int slots, long long budget)
+    : page_size(page_size), budget(budget), entries(slots), links(slots),
+      free_chunks(sizeClass(page_size) + 1), block_used(BLOCK_SIZE), buffer(page_size),
+      pool_bytes(0), peak_pool_bytes(0), bytes_in(0), bytes_out(0), same_filled(0),
+      stores(0), rejected(0), loads(0), hits(0), spills(0) {
+    for (pool_entry &entry : entries) {
+        entry.data = nullptr;
+        entry.size = 0;
+        entry.kind = ABSENT;
+        entry.fill = 0;
+    }
+}
+
+compressed_swap::~compressed_swap() {
+    for (char* block : blocks)
+        free(block);
+}
+
+// a free chunk of the size class, reused or carved out of the current block
+char* compressed_swap::allocateChunk(int size_class) {
+    std::vector<char*> &chunks = free_chunks[size_class];
+    if(!chunks.empty()) {
+        char* chunk = chunks.back();
+        chunks.pop_back();
+        return chunk;
+    }
+    size_t size = (size_t)size_class * CLASS_SIZE;
+    if(block_used + size > BLOCK_SIZE || blocks.empty()) {
+        char* block = (char*)malloc(size > BLOCK_SIZE ? size : BLOCK_SIZE);
+        if(block == nullptr) {
+            perror("ERR");
+            exit(1);
+        }
+        blocks.push_back(block);
+        block_used = 0;
+    }
+    char* chunk = blocks.back() + block_used;
+    block_used += size;
+    return chunk;
+}
+
+bool compressed_swap::store(int slot, const char* page) {
+    drop(slot);
+    pool_entry &entry = entries[slot];
+    // same-filled pages need no compression and no chunk
+    int i = 1;
+    while (i < page_size && page[i] == page[0])
+        i++;
+    if(i == page_size) {
+        entry.kind = SAME_FILLED;
+        entry.fill = page[0];
+        same_filled++;
+        stores++;
+        return true;
+    }
+
+    int size = lz_compress(page, page_size, buffer.data(), page_size - page_size / 8);
+    if(size == 0) {
+        rejected++;
+        return false;
+    }
+    entry.kind = COMPRESSED;
+    entry.size = size;
+    entry.data = allocateChunk(sizeClass(size));
+    memcpy(entry.data, buffer.data(), size);
+    lru.push_back(slot, links);
+    pool_bytes += (long long)sizeClass(size) * CLASS_SIZE;
+    if(pool_bytes > peak_pool_bytes)
+        peak_pool_bytes = pool_bytes;
+    bytes_in += page_size;
+    bytes_out += size;
+    stores++;
+    return true;
+}
+
+bool compressed_swap::peek(int slot, char* dst) const {
+    const pool_entry &entry = entries[slot];
+    if(entry.kind == SAME_FILLED) {
+        memset(dst, entry.fill, page_size);
+        return true;
+    }
+    if(entry.kind == COMPRESSED)
+        return lz_decompress(entry.data, entry.size, dst, page_size);
+    return false;
+}
+
+bool compressed_swap::load(int slot, char* dst) {
+    loads++;
+    if(!peek(slot, dst))
+        return false;
+    hits++;
+    return true;
+}
+
+void compressed_swap::drop(int slot) {
+    pool_entry &entry = entries[slot];
+    if(entry.kind == SAME_FILLED) {
+        same_filled--;
+    }
+    else if(entry.kind == COMPRESSED) {
+        lru.unlink(slot, links);
+        free_chunks[sizeClass(entry.size)].push_back(entry.data);
+        pool_bytes -= (long long)sizeClass(entry.size) * CLASS_SIZE;
+        entry.data = nullptr;
+        entry.size = 0;
+    }
+    entry.kind = ABSENT;
+}
+
+int compressed_swap::spill(const char** page) {
+    if(pool_bytes <= budget || lru.head == -1)
+        return -1;
+    int slot = lru.head;
+    *page = buffer.data();
+    if(!peek(slot, buffer.data())) { // the pool's own data can't be corrupt
+        std::cout << "ERR" << std::endl;
+        exit(1);
+    }
+    drop(slot);
+    spills++;
+    return slot;
+}
+
+zswap_usage compressed_swap::usage() const {
+    zswap_usage usage;
+    usage.budget = budget;
+    usage.pool_bytes = pool_bytes;
+    usage.peak_pool_bytes = peak_pool_bytes;
+    usage.compressed_pages = lru.size;
+    usage.same_filled_pages = same_filled;
+    usage.ratio = bytes_out == 0 ? 0.0 : (double)bytes_in / bytes_out;
+    usage.stores = stores;
+    usage.rejected = rejected;
+    usage.loads = loads;
+    usage.hits = hits;
+    usage.spills = spills;
+    return usage;
+}
@@ -0,0 +1,87 @@
+#ifndef OS_EX4_COMPRESSED_SWAP_H
+#define OS_EX4_COMPRESSED_SWAP_H
+
+#include <cstddef>
+#include <vector>
+
+#include "replacement_policy.h"
+
+// counters and occupancy of the compressed swap pool
+typedef struct zswap_usage {
+    long long budget;          // bytes the pool may hold before it spills to the swap file
+    long long pool_bytes;      // arena bytes held by compressed pages
+    long long peak_pool_bytes;
+    int compressed_pages;      // pages in the pool
+    int same_filled_pages;     // pages kept as their one repeated byte, they take no pool bytes
+    double ratio;              // bytes of the pages compressed so far / bytes they compressed to
+    long stores;               // evicted pages the pool took
+    long rejected;             // pages that didn't compress well enough and went to the file
+    long loads;                // swap-ins
+    long hits;                 // swap-ins served from the pool, no disk I/O
+    long spills;               // oldest pages written to the file to stay within budget
+} zswap_usage;
+
+// a zswap-style cache in front of the swap file, keyed by swap slot. evicted pages are kept
+// compressed (with lz_codec) in size-classed chunks of a pooled arena, pages of one repeated
+// byte (the '0' pages of a fresh bss or heap) as just that byte. when the pool grows past its
+// budget the least recently stored pages are handed back for the caller to write to the file.
+// not thread safe, concurrent mode calls it under the swap lock
+class compressed_swap {
+    enum entry_kind { ABSENT, SAME_FILLED, COMPRESSED };
+    struct pool_entry {
+        char* data;       // the chunk holding the compressed page
+        int size;         // compressed bytes
+        char kind;
+        char fill;        // SAME_FILLED byte
+    };
+
+    int page_size;
+    long long budget;
+    std::vector<pool_entry> entries;  // by slot
+    id_links links;
+    id_list lru;                      // compressed pages, oldest first
+    std::vector<std::vector<char*>> free_chunks; // by size class
+    std::vector<char*> blocks;
+    size_t block_used;
+    std::vector<char> buffer;         // compression output before it gets its chunk, spilled pages
+
+    long long pool_bytes;
+    long long peak_pool_bytes;
+    long long bytes_in;               // of every page compressed so far, for the ratio
+    long long bytes_out;
+    int same_filled;
+    long stores;
+    long rejected;
+    long loads;
+    long hits;
+    long spills;
+
+    static const int CLASS_SIZE = 32;
+    static const size_t BLOCK_SIZE = 256 * 1024;
+
+    static int sizeClass(int size) { return (size + CLASS_SIZE - 1) / CLASS_SIZE; }
+    char* allocateChunk(int size_class);
+
+public:
+    compressed_swap(int page_size, int slots, long long budget);
+    compressed_swap(const compressed_swap&) = delete;
+    compressed_swap& operator=(const compressed_swap&) = delete;
+    ~compressed_swap();
+
+    // keeps a copy of page as slot's content, replacing any older one. false when the page
+    // doesn't compress to at most 7/8 of a page, it should be written to the file instead
+    bool store(int slot, const char* page);
+    // a swap-in: copies slot's page into dst, false when the pool doesn't have it
+    bool load(int slot, char* dst);
+    // copies slot's page into dst like load without counting it
+    bool peek(int slot, char* dst) const;
+    // the slot was freed, its page is gone
+    void drop(int slot);
+    // over budget: takes the least recently stored page out of the pool and returns its slot,
+    // *page points to its content (until the next call) to be written to the file. -1 when the
+    // pool is within its budget
+    int spill(const char** page);
+    zswap_usage usage() const;
+};
+
+#endif //OS_EX4_COMPRESSED_SWAP_H
@@ -0,0 +1,167 @@
+#include "lz_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+#define HASH_BITS 12
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+// as in LZ4, a block always ends with a few literals
+#define LAST_LITERALS 5
+
+static uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static int hash32(uint32_t value) {
+    return (int)((value * 2654435761u) >> (32 - HASH_BITS));
+}
+
+// the rest of a length that didn't fit in its nibble, as bytes of 255 and a final smaller one
+static char* putLength(char* op, const char* end, int length) {
+    while (length >= 255) {
+        if(op >= end)
+            return nullptr;
+        *op++ = (char)255;
+        length -= 255;
+    }
+    if(op >= end)
+        return nullptr;
+    *op++ = (char)length;
+    return op;
+}
+
+// appends one sequence, match_length 0 for the last one. nullptr when it doesn't fit
+static char* putSequence(char* op, const char* end, const char* literals, int literal_length,
+                         int offset, int match_length) {
+    if(op >= end)
+        return nullptr;
+    char* token = op++;
+    int high = literal_length >= 15 ? 15 : literal_length;
+    int low = 0;
+    if(literal_length >= 15 && (op = putLength(op, end, literal_length - 15)) == nullptr)
+        return nullptr;
+    if(end - op < literal_length)
+        return nullptr;
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+    if(match_length > 0) {
+        if(end - op < 2)
+            return nullptr;
+        *op++ = (char)(offset & 0xff);
+        *op++ = (char)(offset >> 8);
+        int extra = match_length - MIN_MATCH;
+        low = extra >= 15 ? 15 : extra;
+        if(extra >= 15 && (op = putLength(op, end, extra - 15)) == nullptr)
+            return nullptr;
+    }
+    *token = (char)(high << 4 | low);
+    return op;
+}
+
+int lz_compress(const char* src, int n, char* dst, int capacity) {
+    int table[1 << HASH_BITS];
+    memset(table, 0xff, sizeof(table)); // all -1, no position seen yet
+    char* op = dst;
+    const char* end = dst + capacity;
+    int anchor = 0;
+    int ip = 0;
+    // a match has to start early enough to leave the last literals after it
+    int limit = n - LAST_LITERALS - MIN_MATCH;
+    while (ip <= limit) {
+        uint32_t sequence = read32(src + ip);
+        int slot = hash32(sequence);
+        int ref = table[slot];
+        table[slot] = ip;
+        if(ref < 0 || ip - ref > MAX_OFFSET || read32(src + ref) != sequence) {
+            // the longer nothing matched, the bigger the steps over data that doesn't compress
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        // extended 8 bytes at a time, the first differing byte is found from the xor
+        int length = MIN_MATCH;
+        int max_length = n - LAST_LITERALS - ip;
+        while (length + 8 <= max_length) {
+            uint64_t a, b;
+            memcpy(&a, src + ref + length, 8);
+            memcpy(&b, src + ip + length, 8);
+            if(a != b) {
+                length += __builtin_ctzll(a ^ b) / 8;
+                break;
+            }
+            length += 8;
+        }
+        if(length + 8 > max_length) {
+            while (length < max_length && src[ref + length] == src[ip + length])
+                length++;
+        }
+        op = putSequence(op, end, src + anchor, ip - anchor, ip - ref, length);
+        if(op == nullptr)
+            return 0;
+        ip += length;
+        anchor = ip;
+    }
+    op = putSequence(op, end, src + anchor, n - anchor, 0, 0);
+    if(op == nullptr)
+        return 0;
+    return (int)(op - dst);
+}
+
+bool lz_decompress(const char* src, int size, char* dst, int n) {
+    const unsigned char* ip = (const unsigned char*)src;
+    const unsigned char* end = ip + size;
+    int op = 0;
+    while (ip < end) {
+        int token = *ip++;
+        int literals = token >> 4;
+        if(literals == 15) {
+            int more;
+            do {
+                if(ip >= end)
+                    return false;
+                more = *ip++;
+                literals += more;
+            } while (more == 255);
+        }
+        if(literals > end - ip || literals > n - op)
+            return false;
+        memcpy(dst + op, ip, literals);
+        ip += literals;
+        op += literals;
+        if(ip == end) // the last sequence has no match
+            return op == n;
+
+        if(end - ip < 2)
+            return false;
+        int offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if(offset == 0 || offset > op)
+            return false;
+        int length = token & 15;
+        if(length == 15) {
+            int more;
+            do {
+                if(ip >= end)
+                    return false;
+                more = *ip++;
+                length += more;
+            } while (more == 255);
+        }
+        length += MIN_MATCH;
+        if(length > n - op)
+            return false;
+        // a match closer than its length overlaps the bytes it produces (a run of one repeated
+        // byte), those are copied byte by byte
+        if(offset >= length) {
+            memcpy(dst + op, dst + op - offset, length);
+        }
+        else {
+            for (int i = 0; i < length; i++)
+                dst[op + i] = dst[op - offset + i];
+        }
+        op += length;
+    }
+    return false;
+}
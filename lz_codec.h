@@ -0,0 +1,17 @@
+#ifndef OS_EX4_LZ_CODEC_H
+#define OS_EX4_LZ_CODEC_H
+
+// a small LZ77 block codec in the LZ4 block format: sequences of a token (literal length in the
+// high nibble, match length - 4 in the low one, 15 meaning more length bytes follow), the
+// literals and a 2 byte little endian offset back to the match. the last sequence has literals
+// only. a greedy single-probe hash match finder keeps compression at a few hundred MB/s,
+// enough for pages the simulator evicts
+
+// compresses n bytes of src into dst, returns the compressed size or 0 when it would take more
+// than capacity bytes
+int lz_compress(const char* src, int n, char* dst, int capacity);
+
+// decompresses a block made by lz_compress, returns false unless it decodes to exactly n bytes
+bool lz_decompress(const char* src, int size, char* dst, int n);
+
+#endif //OS_EX4_LZ_CODEC_H
@@ -0,0 +1,138 @@
+#include "page_table.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+node_arena::~node_arena() {
+    for (char* block : blocks)
+        free(block);
+}
+
+// nodes are carved out of 64KB blocks, bigger ones get a block to themselves
+void* node_arena::allocate(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if(size > BLOCK_SIZE) {
+        char* block = (char*)malloc(size);
+        if(block == nullptr)
+            return nullptr;
+        // keep bumping into the current block, it still has room
+        blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), block);
+        total += size;
+        return block;
+    }
+    if(block_used + size > BLOCK_SIZE) {
+        char* block = (char*)malloc(BLOCK_SIZE);
+        if(block == nullptr)
+            return nullptr;
+        blocks.push_back(block);
+        block_used = 0;
+        total += BLOCK_SIZE;
+    }
+    void* node = blocks.back() + block_used;
+    block_used += size;
+    return node;
+}
+
+bool radix_page_table::init(int levels, const int seg_pages[TABLE_SEGMENTS]) {
+    if(levels < 2 || levels > 4)
+        return false;
+    this->levels = levels;
+    int largest = 1;
+    for (int seg = 0; seg < TABLE_SEGMENTS; seg++) {
+        this->seg_pages[seg] = seg_pages[seg];
+        this->dense[seg] = nullptr;
+        this->root[seg] = nullptr;
+        if(seg_pages[seg] > largest)
+            largest = seg_pages[seg];
+    }
+
+    if(levels == 2) {
+        // the flat layout, every page has its descriptor from the start
+        for (int seg = 0; seg < TABLE_SEGMENTS; seg++) {
+            dense[seg] = new page_descriptor[seg_pages[seg]];
+            for (int i = 0; i < seg_pages[seg]; ++i) {
+                dense[seg][i].valid = false;
+                dense[seg][i].frame = -1;
+                dense[seg][i].dirty = false;
+                dense[seg][i].in_swap = false;
+                dense[seg][i].prefetched = false;
+                dense[seg][i].swap_index = -1;
+            }
+        }
+        return true;
+    }
+
+    // the page number bits of the largest segment are split evenly over the levels below the
+    // segment, the leaves take the low ones
+    int page_bits = 1;
+    while ((1LL << page_bits) < largest)
+        page_bits++;
+    int below = levels - 1;
+    int bits = (page_bits + below - 1) / below;
+    int shift_below = 0;
+    for (int level = levels - 1; level >= 1; level--) {
+        int level_bits = level == 1 ? page_bits - shift_below : bits;
+        if(level_bits < 1)
+            level_bits = 1;
+        this->shift[level] = shift_below;
+        this->mask[level] = (1 << level_bits) - 1;
+        this->node_entries[level] = (size_t)1 << level_bits;
+        shift_below += level_bits;
+    }
+    return true;
+}
+
+// a zeroed interior node, or a leaf of descriptors of unmapped pages
+void* radix_page_table::newNode(int level) {
+    if(level < levels - 1) {
+        void* node = arena.allocate(node_entries[level] * sizeof(void*));
+        if(node == nullptr) {
+            perror("ERR");
+            exit(1);
+        }
+        memset(node, 0, node_entries[level] * sizeof(void*));
+        return node;
+    }
+    page_descriptor* leaf = (page_descriptor*)arena.allocate(node_entries[level] * sizeof(page_descriptor));
+    if(leaf == nullptr) {
+        perror("ERR");
+        exit(1);
+    }
+    for (size_t i = 0; i < node_entries[level]; ++i) {
+        leaf[i].valid = false;
+        leaf[i].frame = -1;
+        leaf[i].dirty = false;
+        leaf[i].in_swap = false;
+        leaf[i].prefetched = false;
+        leaf[i].swap_index = -1;
+    }
+    return leaf;
+}
+
+const page_descriptor* radix_page_table::find(int out, int in) const {
+    if(levels == 2)
+        return &dense[out][in];
+    void* node = root[out];
+    for (int level = 1; level < levels - 1 && node != nullptr; level++)
+        node = ((void**)node)[(in >> shift[level]) & mask[level]];
+    if(node == nullptr)
+        return nullptr;
+    return &((page_descriptor*)node)[in & mask[levels - 1]];
+}
+
+size_t radix_page_table::bytes() const {
+    if(levels != 2)
+        return arena.bytes();
+    size_t total = 0;
+    for (int seg = 0; seg < TABLE_SEGMENTS; seg++)
+        total += (size_t)seg_pages[seg] * sizeof(page_descriptor);
+    return total;
+}
+
+radix_page_table::~radix_page_table() {
+    if(levels != 2)
+        return; // the arena frees the nodes
+    for (int seg = 0; seg < TABLE_SEGMENTS; seg++)
+        delete [] dense[seg];
+}
@@ -0,0 +1,134 @@
+#ifndef OS_EX4_PAGE_TABLE_H
+#define OS_EX4_PAGE_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+// one root entry per segment of sim_mem.h
+#define TABLE_SEGMENTS 4
+
+// frames are numbered in the bits of a descriptor left over by the flags
+#define MAX_FRAMES (1 << 27)
+
+// packed into 8 bytes, the flags and the frame share one word so a lookup reads a single one
+typedef struct page_descriptor {
+    bool valid : 1;
+    bool dirty : 1;      // modified since it was loaded, evicting it needs a write to the swap
+    bool in_swap : 1;    // swap_index holds the page's latest copy (unless dirty)
+    bool prefetched : 1; // read ahead from the exec and not accessed yet
+    int frame : 28;      // -1 when not valid
+    int swap_index;
+} page_descriptor;
+
+static_assert(sizeof(page_descriptor) == 8, "page descriptors are packed into two words");
+
+// bump allocator for page table nodes, everything is freed together with the table
+class node_arena {
+    std::vector<char*> blocks;
+    size_t block_used;
+    size_t total;
+
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    node_arena() : block_used(BLOCK_SIZE), total(0) {}
+    node_arena(const node_arena&) = delete;
+    node_arena& operator=(const node_arena&) = delete;
+    ~node_arena();
+
+    void* allocate(size_t size);
+    size_t bytes() const { return total; }
+};
+
+// the page descriptors of an address space, indexed by segment (out) and page (in).
+// with 2 levels it is the classic layout: one dense array per segment, allocated up front.
+// with 3 or 4 levels the page number is split over the levels under the segment, like a
+// hardware radix table. interior nodes and leaves come from an arena the first time a page
+// under them is touched, so a sparse segment only pays for the regions it uses
+class radix_page_table {
+    int levels;
+    int seg_pages[TABLE_SEGMENTS];
+    page_descriptor *dense[TABLE_SEGMENTS]; // 2 levels
+    void *root[TABLE_SEGMENTS];             // 3 and 4 levels, the first node under each segment
+    int shift[4];                           // page number bits below each level
+    int mask[4];                            // index bits of each level
+    size_t node_entries[4];
+    node_arena arena;
+
+    void* newNode(int level);
+
+public:
+    // what table[out][in] returns, so call sites read like the two dimensional array
+    struct row {
+        radix_page_table *table;
+        int out;
+        page_descriptor& operator[](int in) const { return table->at(out, in); }
+    };
+
+    radix_page_table() : levels(0) {}
+    radix_page_table(const radix_page_table&) = delete;
+    radix_page_table& operator=(const radix_page_table&) = delete;
+    ~radix_page_table();
+
+    // levels is 2, 3 or 4, false otherwise
+    bool init(int levels, const int seg_pages[TABLE_SEGMENTS]);
+
+    row operator[](int out) { return row{this, out}; }
+
+    // the descriptor of the page, allocating the nodes on its path when they don't exist yet
+    page_descriptor& at(int out, int in) {
+        if(levels == 2)
+            return dense[out][in];
+        void **slot = &root[out];
+        for (int level = 1; level < levels - 1; level++) {
+            if(*slot == nullptr)
+                *slot = newNode(level);
+            slot = (void**)*slot + ((in >> shift[level]) & mask[level]);
+        }
+        if(*slot == nullptr)
+            *slot = newNode(levels - 1);
+        return ((page_descriptor*)*slot)[in & mask[levels - 1]];
+    }
+
+    // the descriptor of the page, nullptr when no node on its path was allocated (the page was
+    // never touched)
+    const page_descriptor* find(int out, int in) const;
+    page_descriptor* find(int out, int in) {
+        return const_cast<page_descriptor*>(static_cast<const radix_page_table*>(this)->find(out, in));
+    }
+
+    // calls visit(out, in, descriptor) for every page with a descriptor, in address order
+    template <class Visit>
+    void for_each(Visit visit) {
+        for (int out = 0; out < TABLE_SEGMENTS; out++) {
+            if(levels == 2) {
+                for (int in = 0; in < seg_pages[out]; in++)
+                    visit(out, in, dense[out][in]);
+            }
+            else {
+                walk(root[out], 1, 0, out, visit);
+            }
+        }
+    }
+
+    int depth() const { return levels; }
+    // memory taken by the descriptors and the nodes
+    size_t bytes() const;
+
+private:
+    template <class Visit>
+    void walk(void* node, int level, int first, int out, Visit& visit) {
+        if(node == nullptr || first >= seg_pages[out])
+            return;
+        if(level == levels - 1) {
+            page_descriptor *leaf = (page_descriptor*)node;
+            for (size_t i = 0; i < node_entries[level] && first + (int)i < seg_pages[out]; i++)
+                visit(out, first + (int)i, leaf[i]);
+            return;
+        }
+        for (size_t i = 0; i < node_entries[level]; i++)
+            walk(((void**)node)[i], level + 1, first + (int)(i << shift[level]), out, visit);
+    }
+};
+
+#endif //OS_EX4_PAGE_TABLE_H
@@ -0,0 +1,249 @@
+#include "physical_memory.h"
+#include "sim_mem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// maps anonymous memory for the physical frames, it comes page aligned from the kernel.
+// with huge_pages it first asks for explicit huge pages and falls back to transparent ones
+static char* map_physical_memory(size_t size, bool huge_pages, size_t* mapped_size)
+{
+    void* memory = MAP_FAILED;
+    if(huge_pages) {
+        size_t rounded = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(memory != MAP_FAILED) {
+            *mapped_size = rounded;
+            return (char*)memory;
+        }
+    }
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED)
+        return NULL;
+    if(huge_pages)
+        madvise(memory, size, MADV_HUGEPAGE);
+    *mapped_size = size;
+    return (char*)memory;
+}
+
+physical_memory::physical_memory(const char* swap_file_name, int page_size, long long swap_size, const sim_config& config) {
+    if(page_size <= 0 || config.memory_size < page_size || config.memory_size / page_size > MAX_FRAMES ||
+       swap_size < 0 || swap_file_name == NULL)
+    {
+        cout << "ERR" << endl;
+        exit(1);
+    }
+    this->page_size = page_size;
+    this->memory_size = config.memory_size;
+    this->num_frames = (int)(memory_size / page_size);
+    this->main_memory = map_physical_memory(memory_size, config.huge_pages, &this->memory_map_size);
+    if(this->main_memory == NULL)
+    {
+        perror("ERR");
+        exit(1);
+    }
+    memset(main_memory, '0', memory_size);
+
+    // all frames start out free
+    this->free_frames = new bitmap_allocator(num_frames);
+    this->frames = new frame_descriptor[num_frames];
+    for (int i = 0; i < num_frames; ++i) {
+        frames[i].owner = nullptr;
+        frames[i].segment = -1;
+        frames[i].page = -1;
+        frames[i].mappers = 0;
+    }
+
+    // Open the file, truncating any existing content
+    if (!this->swap_file.open(swap_file_name, O_RDWR | O_CREAT | O_TRUNC, 0666)) {  // Read/write permissions for owner, read permissions for others
+        perror("ERR");
+        exit(1);
+    }
+
+    // the swap starts out as '0's. the file gets its length in one go, its blocks up front
+    // where the filesystem can allocate them, and is filled a megabyte per write
+    int fd = this->swap_file.descriptor();
+    if(ftruncate(fd, swap_size) == -1) {
+        perror("ERR");
+        exit(1);
+    }
+    if(swap_size > 0)
+        fallocate(fd, 0, 0, swap_size); // only a hint, the writes below allocate anyway
+    std::vector<char> zeros((size_t)std::min<long long>(swap_size, 1 << 20), '0');
+    for (long long done = 0; done < swap_size; ) {
+        ssize_t written = pwrite(fd, zeros.data(), (size_t)std::min<long long>(swap_size - done, zeros.size()), done);
+        if(written <= 0) {
+            perror("ERR");
+            exit(1);
+        }
+        done += written;
+    }
+
+    int slots = (int)(swap_size / page_size);
+    // async swap does its own buffering and read-ahead with pwritev/preadv, so it skips the mapping
+    this->swap_async = nullptr;
+    if(config.async_io != ASYNC_OFF)
+        this->swap_async = new async_swap(swap_file.descriptor(), page_size, slots,
+                                          config.writeback_batch, config.swap_prefetch, config.async_io);
+    else if(swap_file.map(config.io, true) && config.madvise_hints)
+        swap_file.advise(MADV_RANDOM);   // slots are visited in eviction order, read-ahead is wasted
+    this->swap_slots = new bitmap_allocator(slots);
+    this->zswap = nullptr;
+    if(config.zswap_budget > 0)
+        this->zswap = new compressed_swap(page_size, slots, config.zswap_budget);
+    this->swap_peak = 0;
+    this->swap_clustering = config.swap_clustering;
+    this->swap_reads = 0;
+    this->swap_writes = 0;
+
+    // global replacement has one policy, its key space grows as address spaces attach.
+    // a concurrent simulator sweeps its own CLOCK instead
+    this->scope = config.scope;
+    this->policy_kind = config.policy;
+    this->policy = nullptr;
+    if(scope == GLOBAL_REPLACEMENT && !config.concurrent) {
+        this->policy = make_policy(policy_kind, num_frames, 0);
+        if(this->policy == nullptr)
+        {
+            cout << "ERR" << endl;
+            exit(1);
+        }
+    }
+    this->next_key = 0;
+    this->frames_reserved = 0;
+    this->swap_reserved = 0;
+    this->share_text = config.share_text;
+}
+
+// reserves what a new address space needs: num_pages policy keys, swap slots for its non-text
+// pages and its frame quota. both reservations have to fit, the swap can't be overcommitted
+// since a page being evicted has nowhere else to go
+void physical_memory::attach(sim_mem* space, int num_pages, int swap_pages, int quota) {
+    if(swap_reserved + swap_pages > swap_slots->capacity() ||
+       (scope == LOCAL_REPLACEMENT && (quota <= 0 || frames_reserved + quota > num_frames)))
+    {
+        cout << "ERR" << endl;
+        exit(1);
+    }
+    space->key_base = next_key;
+    space->swap_base = swap_reserved;
+    next_key += num_pages;
+    if(policy != nullptr)
+        policy->reserve_keys(next_key);
+    swap_reserved += swap_pages;
+    frames_reserved += quota;
+    spaces.push_back(space);
+}
+
+// policy keys aren't handed out again, only the swap and the frame quota are given back
+void physical_memory::detach(sim_mem* space, int swap_pages, int quota) {
+    swap_reserved -= swap_pages;
+    frames_reserved -= quota;
+    spaces.erase(std::find(spaces.begin(), spaces.end(), space));
+}
+
+// index of the executable open on fd, two address spaces run the same one when the file is the same
+int physical_memory::execId(int fd) {
+    struct stat st;
+    if(fstat(fd, &st) == -1)
+        return -1;
+    std::pair<dev_t, ino_t> file(st.st_dev, st.st_ino);
+    for (size_t i = 0; i < execs.size(); i++) {
+        if(execs[i] == file)
+            return (int)i;
+    }
+    execs.push_back(file);
+    return (int)execs.size() - 1;
+}
+
+// an address space other than except that maps the shared text frame
+sim_mem* physical_memory::otherMapper(int frame, sim_mem* except) {
+    int page = frames[frame].page;
+    for (sim_mem* space : spaces) {
+        if(space != except && page < space->seg_pages[TEXT_SEGMENT] && space->mapsFrame(page, frame))
+            return space;
+    }
+    return nullptr;
+}
+
+// the replacement policy picked this frame, every address space mapping it lets go of its page.
+// the frame itself stays allocated for the faulting page
+void physical_memory::reclaimFrame(int frame) {
+    frame_descriptor &victim = frames[frame];
+    sim_mem* owner = victim.owner;
+    if(victim.segment == TEXT_SEGMENT && owner->share_text) {
+        text_frames.erase(textKey(owner->exec_id, victim.page));
+        if(victim.mappers > 1) {
+            for (sim_mem* space : spaces) {
+                if(space != owner)
+                    space->unmapShared(frame, victim.page);
+            }
+        }
+    }
+    owner->evictResident(victim.segment, victim.page);
+    victim.owner = nullptr;
+    victim.mappers = 0;
+}
+
+zswap_usage physical_memory::zswap_stats()
+{
+    if(zswap != nullptr)
+        return zswap->usage();
+    zswap_usage usage;
+    memset(&usage, 0, sizeof(usage));
+    return usage;
+}
+
+// slot occupancy and how scattered the free slots are
+swap_usage physical_memory::swap_slot_usage()
+{
+    swap_usage usage;
+    usage.capacity = swap_slots->capacity();
+    usage.used = usage.capacity - swap_slots->available();
+    usage.peak_used = swap_peak;
+    usage.free_extents = swap_slots->free_runs(&usage.largest_free_extent);
+    int free_slots = swap_slots->available();
+    usage.fragmentation = free_slots == 0 ? 0.0 : 1.0 - (double)usage.largest_free_extent / free_slots;
+    usage.reads = swap_reads;
+    usage.writes = swap_writes;
+    return usage;
+}
+
+void physical_memory::print_memory() {
+    printf("\n Physical memory:\n");
+    for (long long i = 0; i < memory_size; i++) {
+        printf("[%c]\n", main_memory[i]);
+    }
+}
+
+void physical_memory::print_swap() {
+    char* str = (char*)malloc(this->page_size * sizeof(char));
+    printf("\n Swap memory\n");
+    if(swap_async != nullptr)
+        swap_async->drain(); // the file has to catch up with the write-back buffer
+    off_t position = 0; // from the start of the file
+    while(swap_file.read(str, position, this->page_size) == this->page_size) {
+        // the pool's copy is newer than the file's
+        if(zswap != nullptr)
+            zswap->peek((int)(position / page_size), str);
+        position += page_size;
+        for (int i = 0; i < page_size; i++) {
+            printf("%d - [%c]\t", i, str[i]);
+        }
+        printf("\n");
+    }
+}
+
+physical_memory::~physical_memory() {
+    delete policy;
+    delete swap_async; // drains the write-back buffer into the swap file
+    delete zswap;
+    delete swap_slots;
+    delete free_frames;
+    delete[] frames;
+    munmap(main_memory, memory_map_size);
+}
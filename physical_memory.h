@@ -0,0 +1,114 @@
+#ifndef OS_EX4_PHYSICAL_MEMORY_H
+#define OS_EX4_PHYSICAL_MEMORY_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "async_swap.h"
+#include "backing_file.h"
+#include "bitmap_allocator.h"
+#include "compressed_swap.h"
+#include "replacement_policy.h"
+
+class sim_mem;
+struct sim_config;
+
+// which pages a fault may evict when several address spaces share a physical memory
+enum replacement_scope {
+    GLOBAL_REPLACEMENT, // one policy over every frame, any address space's page can go
+    LOCAL_REPLACEMENT   // each address space has its own policy and replaces its own pages
+                        // once it holds its frame quota
+};
+
+// per frame metadata, which page currently owns the frame
+typedef struct frame_descriptor {
+    sim_mem* owner;  // the address space charged for the frame, nullptr while free
+    int segment;
+    int page;
+    int mappers;     // address spaces mapping the frame, above 1 only for shared text
+} frame_descriptor;
+
+// occupancy of the swap file
+typedef struct swap_usage {
+    int capacity;            // slots in the swap file
+    int used;
+    int peak_used;
+    int free_extents;        // maximal runs of free slots
+    int largest_free_extent;
+    double fragmentation;    // 1 - largest_free_extent / free slots, 0 when the free space is one run
+    long reads;              // reads from the swap, a whole large page is one
+    long writes;             // writes to the swap, a whole large page is one
+} swap_usage;
+
+// the frames and the swap file. a sim_mem built with the plain constructors owns a private one,
+// any number of sim_mem address spaces can also be attached to one physical_memory and compete
+// for its frames and swap slots. text pages read from the same executable are loaded once and
+// mapped by every address space running it. the physical_memory must outlive its address spaces
+// and none of this is thread safe (concurrent mode needs a private physical memory).
+class physical_memory {
+    friend class sim_mem;
+
+    int page_size;
+    char *main_memory;
+    long long memory_size;
+    size_t memory_map_size;  // length of the mapping behind main_memory
+    int num_frames;
+    frame_descriptor *frames;
+    bitmap_allocator *free_frames;
+
+    backing_file swap_file;
+    async_swap *swap_async;  // nullptr unless async swap I/O is on
+    compressed_swap *zswap;  // nullptr unless the compressed swap pool is on
+    bitmap_allocator *swap_slots;
+    int swap_peak;
+    bool swap_clustering;
+    long swap_reads;
+    long swap_writes;
+
+    replacement_scope scope;
+    policy_type policy_kind;
+    replacement_policy *policy; // GLOBAL_REPLACEMENT only, over the keys of every address space
+    int next_key;               // first policy key of the next address space to attach
+
+    std::vector<sim_mem*> spaces;
+    int frames_reserved;     // sum of the frame quotas, LOCAL_REPLACEMENT
+    int swap_reserved;       // swap slots the attached address spaces may need
+    bool share_text;
+    std::vector<std::pair<dev_t, ino_t>> execs;   // executables seen so far, by index
+    std::unordered_map<uint64_t, int> text_frames; // (exec index, text page) -> frame
+
+    static uint64_t textKey(int exec, int page) { return (uint64_t)exec << 32 | (uint32_t)page; }
+    int execId(int fd);
+    void attach(sim_mem* space, int num_pages, int swap_pages, int quota);
+    void detach(sim_mem* space, int swap_pages, int quota);
+    sim_mem* otherMapper(int frame, sim_mem* except);
+    void releaseSlot(int slot) {
+        swap_slots->release(slot);
+        if(zswap != nullptr)
+            zswap->drop(slot);
+    }
+    void reclaimFrame(int frame);
+
+public:
+    // swap_size bytes of swap are shared by the non-text pages of all the address spaces, the
+    // machine settings (memory, I/O, swap, policy and scope) come from config
+    physical_memory(const char* swap_file_name, int page_size, long long swap_size, const sim_config& config);
+    physical_memory(const physical_memory&) = delete;
+    physical_memory& operator=(const physical_memory&) = delete;
+    ~physical_memory();
+
+    int frame_count() const { return num_frames; }
+    int free_frame_count() const { return free_frames->available(); }
+    int page_bytes() const { return page_size; }
+    swap_usage swap_slot_usage();
+    // all zero when the compressed swap pool is off
+    zswap_usage zswap_stats();
+    void print_memory();
+    void print_swap();
+};
+
+#endif //OS_EX4_PHYSICAL_MEMORY_H
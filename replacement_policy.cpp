@@ -0,0 +1,423 @@
+#include "replacement_policy.h"
+
+#include <algorithm>
+#include <cstring>
+
+const char* policy_name(policy_type type) {
+    switch (type) {
+        case LRU_POLICY: return "lru";
+        case CLOCK_POLICY: return "clock";
+        case TWO_Q_POLICY: return "2q";
+        case ARC_POLICY: return "arc";
+        case LFU_POLICY: return "lfu";
+        default: return "unknown";
+    }
+}
+
+bool parse_policy(const char* name, policy_type* type) {
+    const policy_type all[] = {LRU_POLICY, CLOCK_POLICY, TWO_Q_POLICY, ARC_POLICY, LFU_POLICY};
+    for (policy_type candidate : all) {
+        if(strcmp(name, policy_name(candidate)) == 0) {
+            *type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+replacement_policy* make_policy(policy_type type, int num_frames, int num_pages) {
+    switch (type) {
+        case LRU_POLICY: return new lru_policy(num_frames);
+        case CLOCK_POLICY: return new clock_policy(num_frames);
+        case TWO_Q_POLICY: return new two_q_policy(num_frames, num_pages);
+        case ARC_POLICY: return new arc_policy(num_frames, num_pages);
+        case LFU_POLICY: return new lfu_policy(num_frames);
+        default: return nullptr;
+    }
+}
+
+// ---------------------------------------------------------------- CLOCK
+
+int clock_policy::select_victim() {
+    int num_frames = (int)occupied.size();
+    // two full sweeps are enough: the first one clears every reference bit
+    for (int steps = 0; steps < 2 * num_frames + 1; steps++) {
+        int frame = hand;
+        hand = (hand + 1) % num_frames;
+        if(!occupied[frame])
+            continue;
+        if(referenced[frame]) {
+            referenced[frame] = 0; // second chance
+            continue;
+        }
+        occupied[frame] = 0;
+        return frame;
+    }
+    return -1;
+}
+
+// the frames the hand reaches next with the reference bit clear, the ones it would spare are left out
+int clock_policy::next_victims(int* frames, int max) const {
+    int num_frames = (int)occupied.size(), found = 0;
+    for (int steps = 0; steps < num_frames && found < max; steps++) {
+        int frame = (hand + steps) % num_frames;
+        if(occupied[frame] && !referenced[frame])
+            frames[found++] = frame;
+    }
+    return found;
+}
+
+// ---------------------------------------------------------------- 2Q
+
+two_q_policy::two_q_policy(int num_frames, int num_pages)
+    : links(num_pages), where(num_pages, NONE), frame_of(num_pages, -1), key_of(num_frames, -1) {
+    // the sizes recommended in the paper: A1in holds 25% of the frames, A1out remembers 50%
+    kin = std::max(1, num_frames / 4);
+    kout = std::max(1, num_frames / 2);
+}
+
+void two_q_policy::on_insert(int frame, int key) {
+    if(where[key] == A1OUT) { // seen recently, it is hot
+        a1out.unlink(key, links);
+        am.push_back(key, links);
+        where[key] = AM;
+    }
+    else {
+        a1in.push_back(key, links);
+        where[key] = A1IN;
+    }
+    frame_of[key] = frame;
+    key_of[frame] = key;
+}
+
+void two_q_policy::on_hit(int frame) {
+    int key = key_of[frame];
+    // hits in A1in are ignored on purpose, they are usually correlated references
+    if(where[key] == AM)
+        am.move_to_back(key, links);
+}
+
+int two_q_policy::select_victim() {
+    int key;
+    if(a1in.size > kin || am.size == 0) {
+        key = a1in.pop_front(links);
+        // remember the page so a second fault promotes it
+        a1out.push_back(key, links);
+        where[key] = A1OUT;
+        if(a1out.size > kout)
+            where[a1out.pop_front(links)] = NONE;
+    }
+    else {
+        key = am.pop_front(links);
+        where[key] = NONE;
+    }
+    int frame = frame_of[key];
+    frame_of[key] = -1;
+    key_of[frame] = -1;
+    return frame;
+}
+
+void two_q_policy::on_remove(int frame) {
+    int key = key_of[frame];
+    (where[key] == A1IN ? a1in : am).unlink(key, links);
+    where[key] = NONE;
+    frame_of[key] = -1;
+    key_of[frame] = -1;
+}
+
+// the oldest of A1in while it is over kin, then the oldest of Am
+int two_q_policy::next_victims(int* frames, int max) const {
+    int found = 0;
+    for (int key = a1in.head; key != -1 && found < max && found < a1in.size - kin; key = links.next[key])
+        frames[found++] = frame_of[key];
+    for (int key = am.head; key != -1 && found < max; key = links.next[key])
+        frames[found++] = frame_of[key];
+    return found;
+}
+
+void two_q_policy::reserve_keys(int num_pages) {
+    links.grow(num_pages);
+    if(num_pages > (int)where.size()) {
+        where.resize(num_pages, NONE);
+        frame_of.resize(num_pages, -1);
+    }
+}
+
+void two_q_policy::save(state_writer& out) const {
+    links.save(out);
+    out.put(a1in);
+    out.put(a1out);
+    out.put(am);
+    out.put(where);
+    out.put(frame_of);
+    out.put(key_of);
+    out.put(kin);
+    out.put(kout);
+}
+
+bool two_q_policy::restore(state_reader& in) {
+    links.restore(in);
+    in.get(a1in);
+    in.get(a1out);
+    in.get(am);
+    in.get(where);
+    in.get(frame_of);
+    in.get(key_of);
+    in.get(kin);
+    in.get(kout);
+    return in.ok;
+}
+
+// ---------------------------------------------------------------- ARC
+
+arc_policy::arc_policy(int num_frames, int num_pages)
+    : links(num_pages), where(num_pages, NONE), frame_of(num_pages, -1), key_of(num_frames, -1),
+      c(num_frames), p(0), fault_in_b2(false), drop_t1(false) {}
+
+void arc_policy::on_fault(int key) {
+    fault_in_b2 = false;
+    drop_t1 = false;
+    if(where[key] == B1) { // recency was undersized, grow T1
+        p = std::min(c, p + std::max(b2.size / b1.size, 1));
+    }
+    else if(where[key] == B2) { // frequency was undersized, shrink T1
+        p = std::max(0, p - std::max(b1.size / b2.size, 1));
+        fault_in_b2 = true;
+    }
+    // compared with >= rather than ==: a fault on a large page may take several victims, which
+    // can push the ghost lists past their sizes
+    else if(t1.size + b1.size >= c) {
+        if(t1.size < c)
+            where[b1.pop_front(links)] = NONE;
+        else
+            drop_t1 = true;
+    }
+    else if(t1.size + t2.size + b1.size + b2.size >= c) {
+        if(t1.size + t2.size + b1.size + b2.size >= 2 * c)
+            where[b2.pop_front(links)] = NONE;
+    }
+}
+
+void arc_policy::on_insert(int frame, int key) {
+    if(where[key] == B1 || where[key] == B2) {
+        (where[key] == B1 ? b1 : b2).unlink(key, links);
+        t2.push_back(key, links);
+        where[key] = T2;
+    }
+    else {
+        t1.push_back(key, links);
+        where[key] = T1;
+    }
+    frame_of[key] = frame;
+    key_of[frame] = key;
+}
+
+void arc_policy::on_hit(int frame) {
+    int key = key_of[frame];
+    if(where[key] == T1)
+        t1.unlink(key, links);
+    else
+        t2.unlink(key, links);
+    t2.push_back(key, links);
+    where[key] = T2;
+}
+
+int arc_policy::select_victim() {
+    int key;
+    if(drop_t1) {
+        key = t1.pop_front(links);
+        where[key] = NONE;
+        drop_t1 = false;
+    }
+    else if(t1.size > 0 && (t1.size > p || (fault_in_b2 && t1.size == p) || t2.size == 0)) {
+        key = t1.pop_front(links);
+        b1.push_back(key, links);
+        where[key] = B1;
+    }
+    else {
+        key = t2.pop_front(links);
+        b2.push_back(key, links);
+        where[key] = B2;
+    }
+    int frame = frame_of[key];
+    frame_of[key] = -1;
+    key_of[frame] = -1;
+    return frame;
+}
+
+void arc_policy::on_remove(int frame) {
+    int key = key_of[frame];
+    (where[key] == T1 ? t1 : t2).unlink(key, links);
+    where[key] = NONE;
+    frame_of[key] = -1;
+    key_of[frame] = -1;
+}
+
+// the oldest of T1 while it is over its target size p, then the oldest of T2
+int arc_policy::next_victims(int* frames, int max) const {
+    int found = 0;
+    for (int key = t1.head; key != -1 && found < max && found < t1.size - p; key = links.next[key])
+        frames[found++] = frame_of[key];
+    for (int key = t2.head; key != -1 && found < max; key = links.next[key])
+        frames[found++] = frame_of[key];
+    return found;
+}
+
+void arc_policy::reserve_keys(int num_pages) {
+    links.grow(num_pages);
+    if(num_pages > (int)where.size()) {
+        where.resize(num_pages, NONE);
+        frame_of.resize(num_pages, -1);
+    }
+}
+
+void arc_policy::save(state_writer& out) const {
+    links.save(out);
+    out.put(t1);
+    out.put(t2);
+    out.put(b1);
+    out.put(b2);
+    out.put(where);
+    out.put(frame_of);
+    out.put(key_of);
+    out.put(c);
+    out.put(p);
+    out.put(fault_in_b2);
+    out.put(drop_t1);
+}
+
+bool arc_policy::restore(state_reader& in) {
+    links.restore(in);
+    in.get(t1);
+    in.get(t2);
+    in.get(b1);
+    in.get(b2);
+    in.get(where);
+    in.get(frame_of);
+    in.get(key_of);
+    in.get(c);
+    in.get(p);
+    in.get(fault_in_b2);
+    in.get(drop_t1);
+    return in.ok;
+}
+
+// ---------------------------------------------------------------- LFU
+
+lfu_policy::lfu_policy(int num_frames)
+    : count(num_frames, 0), stamp(num_frames, 0), pos(num_frames, -1), tick(0) {
+    // age a few times per turnover of the whole memory
+    age_interval = std::max(64u, 8u * (unsigned)num_frames);
+    next_aging = age_interval;
+    heap.reserve(num_frames);
+}
+
+void lfu_policy::sift_up(int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if(!less(heap[i], heap[parent]))
+            break;
+        std::swap(heap[i], heap[parent]);
+        pos[heap[i]] = i;
+        pos[heap[parent]] = parent;
+        i = parent;
+    }
+}
+
+void lfu_policy::sift_down(int i) {
+    int n = (int)heap.size();
+    while (true) {
+        int smallest = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if(l < n && less(heap[l], heap[smallest]))
+            smallest = l;
+        if(r < n && less(heap[r], heap[smallest]))
+            smallest = r;
+        if(smallest == i)
+            break;
+        std::swap(heap[i], heap[smallest]);
+        pos[heap[i]] = i;
+        pos[heap[smallest]] = smallest;
+        i = smallest;
+    }
+}
+
+// halves every count, ties created by the halving can break the heap order so it's rebuilt
+void lfu_policy::age() {
+    for (int frame : heap)
+        count[frame] >>= 1;
+    for (int i = (int)heap.size() / 2 - 1; i >= 0; i--)
+        sift_down(i);
+    next_aging = tick + age_interval;
+}
+
+void lfu_policy::on_insert(int frame, int) {
+    count[frame] = 1;
+    stamp[frame] = ++tick;
+    pos[frame] = (int)heap.size();
+    heap.push_back(frame);
+    sift_up(pos[frame]);
+    if(tick >= next_aging)
+        age();
+}
+
+void lfu_policy::on_hit(int frame) {
+    count[frame]++;
+    stamp[frame] = ++tick;
+    sift_down(pos[frame]); // the key only grows
+    if(tick >= next_aging)
+        age();
+}
+
+// takes the entry at heap index i out, the last entry fills the hole and moves either way
+void lfu_policy::erase(int i) {
+    int frame = heap[i];
+    int last = heap.back();
+    heap.pop_back();
+    pos[frame] = -1;
+    if(frame != last) {
+        heap[i] = last;
+        pos[last] = i;
+        sift_down(i);
+        sift_up(pos[last]);
+    }
+}
+
+int lfu_policy::select_victim() {
+    int frame = heap[0];
+    erase(0);
+    return frame;
+}
+
+void lfu_policy::on_remove(int frame) {
+    erase(pos[frame]);
+}
+
+// the top of the heap, the least used frame first and roughly the next least used after it
+int lfu_policy::next_victims(int* frames, int max) const {
+    int found = 0;
+    for (; found < max && found < (int)heap.size(); found++)
+        frames[found] = heap[found];
+    return found;
+}
+
+void lfu_policy::save(state_writer& out) const {
+    out.put(count);
+    out.put(stamp);
+    out.put(heap);
+    out.put(pos);
+    out.put(tick);
+    out.put(age_interval);
+    out.put(next_aging);
+}
+
+bool lfu_policy::restore(state_reader& in) {
+    in.get(count);
+    in.get(stamp);
+    in.get(heap);
+    in.get(pos);
+    in.get(tick);
+    in.get(age_interval);
+    in.get(next_aging);
+    return in.ok;
+}
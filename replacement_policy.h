@@ -0,0 +1,252 @@
+#ifndef OS_EX4_REPLACEMENT_POLICY_H
+#define OS_EX4_REPLACEMENT_POLICY_H
+
+#include <vector>
+
+#include "checkpoint.h"
+
+// page replacement algorithms sim_mem can be constructed with
+enum policy_type {
+    LRU_POLICY,
+    CLOCK_POLICY,
+    TWO_Q_POLICY,
+    ARC_POLICY,
+    LFU_POLICY
+};
+
+const char* policy_name(policy_type type);
+// the policy policy_name() calls name, false if there is none
+bool parse_policy(const char* name, policy_type* type);
+
+// prev/next links for a set of integer ids (frames or page keys), shared by every id_list of a policy
+struct id_links {
+    std::vector<int> prev;
+    std::vector<int> next;
+    explicit id_links(int n) : prev(n, -1), next(n, -1) {}
+    void grow(int n) {
+        if(n > (int)prev.size()) {
+            prev.resize(n, -1);
+            next.resize(n, -1);
+        }
+    }
+    void save(state_writer& out) const {
+        out.put(prev);
+        out.put(next);
+    }
+    void restore(state_reader& in) {
+        in.get(prev);
+        in.get(next);
+    }
+};
+
+// intrusive doubly linked list of ids, head is the oldest entry and tail the newest
+struct id_list {
+    int head = -1;
+    int tail = -1;
+    int size = 0;
+
+    void push_back(int id, id_links& l) {
+        l.prev[id] = tail;
+        l.next[id] = -1;
+        if(tail != -1)
+            l.next[tail] = id;
+        else
+            head = id;
+        tail = id;
+        size++;
+    }
+
+    void unlink(int id, id_links& l) {
+        if(l.prev[id] != -1)
+            l.next[l.prev[id]] = l.next[id];
+        else
+            head = l.next[id];
+        if(l.next[id] != -1)
+            l.prev[l.next[id]] = l.prev[id];
+        else
+            tail = l.prev[id];
+        l.prev[id] = -1;
+        l.next[id] = -1;
+        size--;
+    }
+
+    int pop_front(id_links& l) {
+        int id = head;
+        if(id != -1)
+            unlink(id, l);
+        return id;
+    }
+
+    void move_to_back(int id, id_links& l) {
+        if(id == tail)
+            return;
+        unlink(id, l);
+        push_back(id, l);
+    }
+};
+
+// a frame is an index into main memory, a key identifies one virtual page across all segments.
+// sim_mem only asks for a victim when every frame is taken.
+class replacement_policy {
+public:
+    virtual ~replacement_policy() {}
+    // called on every page fault, before a victim is picked, with the faulting page
+    virtual void on_fault(int key) { (void)key; }
+    // the page with this key was just loaded into frame
+    virtual void on_insert(int frame, int key) = 0;
+    // the page living in frame was accessed while resident
+    virtual void on_hit(int frame) = 0;
+    // chooses a resident frame to evict and stops tracking it
+    virtual int select_victim() = 0;
+    // the frame was freed without being evicted (its address space went away), stop tracking it
+    virtual void on_remove(int frame) = 0;
+    // up to max frames select_victim is about to pick, in that order, without picking them. a
+    // hint for writing dirty pages back ahead of their eviction, a policy may give fewer (none
+    // by default)
+    virtual int next_victims(int* frames, int max) const { (void)frames; (void)max; return 0; }
+    // keys now go up to num_pages, another address space attached to a shared physical memory
+    virtual void reserve_keys(int num_pages) { (void)num_pages; }
+    // writes everything the policy knows for a checkpoint
+    virtual void save(state_writer& out) const = 0;
+    // takes back the state save wrote, false when it's cut short
+    virtual bool restore(state_reader& in) = 0;
+};
+
+// true LRU, the list is ordered by last access
+class lru_policy final : public replacement_policy {
+    id_links links;
+    id_list order;
+public:
+    explicit lru_policy(int num_frames) : links(num_frames) {}
+    void on_insert(int frame, int) override { order.push_back(frame, links); }
+    void on_hit(int frame) override { order.move_to_back(frame, links); }
+    int select_victim() override { return order.pop_front(links); }
+    void on_remove(int frame) override { order.unlink(frame, links); }
+    int next_victims(int* frames, int max) const override {
+        int found = 0;
+        for (int frame = order.head; frame != -1 && found < max; frame = links.next[frame])
+            frames[found++] = frame;
+        return found;
+    }
+    void save(state_writer& out) const override {
+        links.save(out);
+        out.put(order);
+    }
+    bool restore(state_reader& in) override {
+        links.restore(in);
+        in.get(order);
+        return in.ok;
+    }
+};
+
+// second chance, a hand sweeps the frames and spares the ones whose reference bit is set
+class clock_policy final : public replacement_policy {
+    std::vector<unsigned char> referenced;
+    std::vector<unsigned char> occupied;
+    int hand;
+public:
+    explicit clock_policy(int num_frames) : referenced(num_frames, 0), occupied(num_frames, 0), hand(0) {}
+    void on_insert(int frame, int) override { occupied[frame] = 1; referenced[frame] = 1; }
+    void on_hit(int frame) override { referenced[frame] = 1; }
+    int select_victim() override;
+    void on_remove(int frame) override { occupied[frame] = 0; referenced[frame] = 0; }
+    int next_victims(int* frames, int max) const override;
+    void save(state_writer& out) const override {
+        out.put(referenced);
+        out.put(occupied);
+        out.put(hand);
+    }
+    bool restore(state_reader& in) override {
+        in.get(referenced);
+        in.get(occupied);
+        in.get(hand);
+        return in.ok;
+    }
+};
+
+// 2Q (Johnson & Shasha): new pages enter the A1in FIFO, pages faulted again while remembered
+// in the A1out ghost queue are promoted to the Am LRU list
+class two_q_policy final : public replacement_policy {
+    enum { NONE, A1IN, A1OUT, AM };
+    id_links links;
+    id_list a1in, a1out, am;
+    std::vector<unsigned char> where;
+    std::vector<int> frame_of; // key -> frame
+    std::vector<int> key_of;   // frame -> key
+    int kin, kout;
+public:
+    two_q_policy(int num_frames, int num_pages);
+    void on_insert(int frame, int key) override;
+    void on_hit(int frame) override;
+    int select_victim() override;
+    void on_remove(int frame) override;
+    int next_victims(int* frames, int max) const override;
+    void reserve_keys(int num_pages) override;
+    void save(state_writer& out) const override;
+    bool restore(state_reader& in) override;
+};
+
+// ARC (Megiddo & Modha): balances the recency list T1 against the frequency list T2 using the
+// ghost lists B1 and B2 to move the target size p of T1
+class arc_policy final : public replacement_policy {
+    enum { NONE, T1, T2, B1, B2 };
+    id_links links;
+    id_list t1, t2, b1, b2;
+    std::vector<unsigned char> where;
+    std::vector<int> frame_of;
+    std::vector<int> key_of;
+    int c, p;
+    bool fault_in_b2; // the page being faulted in was found in B2
+    bool drop_t1;     // T1 alone fills the cache, evict its LRU page without remembering it
+public:
+    arc_policy(int num_frames, int num_pages);
+    void on_fault(int key) override;
+    void on_insert(int frame, int key) override;
+    void on_hit(int frame) override;
+    int select_victim() override;
+    void on_remove(int frame) override;
+    int next_victims(int* frames, int max) const override;
+    void reserve_keys(int num_pages) override;
+    void save(state_writer& out) const override;
+    bool restore(state_reader& in) override;
+};
+
+// LFU with aging: least use count wins, ties go to the least recently used frame.
+// every age_interval accesses all counts are halved so old popularity fades.
+class lfu_policy final : public replacement_policy {
+    std::vector<unsigned> count;
+    std::vector<unsigned long long> stamp;
+    std::vector<int> heap; // min heap of frames ordered by (count, stamp)
+    std::vector<int> pos;  // frame -> index in heap, -1 if not resident
+    unsigned long long tick;
+    unsigned age_interval;
+    unsigned long long next_aging;
+
+    bool less(int a, int b) const {
+        return count[a] != count[b] ? count[a] < count[b] : stamp[a] < stamp[b];
+    }
+    void sift_up(int i);
+    void sift_down(int i);
+    void age();
+    void erase(int i);
+public:
+    explicit lfu_policy(int num_frames);
+    void on_insert(int frame, int key) override;
+    void on_hit(int frame) override;
+    int select_victim() override;
+    void on_remove(int frame) override;
+    int next_victims(int* frames, int max) const override;
+    void save(state_writer& out) const override;
+    bool restore(state_reader& in) override;
+};
+
+replacement_policy* make_policy(policy_type type, int num_frames, int num_pages);
+
+// calls the concrete policy directly, bypassing the vtable, so sim_mem's hit path can be
+// specialized for the common policies
+template <class Policy>
+inline void policy_hit(replacement_policy* policy, int frame) {
+    static_cast<Policy*>(policy)->Policy::on_hit(frame);
+}
+
+#endif //OS_EX4_REPLACEMENT_POLICY_H
@@ -0,0 +1,123 @@
+#include "reuse_analysis.h"
+
+#include <algorithm>
+
+#define MIN_SLOTS 1024
+
+stack_distance::stack_distance() : cold(0), accesses(0), slots(0), next_slot(0)
+{
+    compact();
+}
+
+// out of slots: the pages keep their order and get the lowest ones, with as many free slots
+// after them as there are pages, so this runs once every that many accesses
+void stack_distance::compact()
+{
+    int live = (int)slot_of.size();
+    int size = std::max(MIN_SLOTS, (2 * live + 63) / 64 * 64);
+    // the pages in the order of their slots
+    std::vector<int> order(std::max(next_slot, 1), -1);
+    for (int page = 0; page < live; page++)
+        order[slot_of[page]] = page;
+    order.erase(std::remove(order.begin(), order.end(), -1), order.end());
+    slots = size;
+    marks.assign(size / 64 + 1, 0); // a word past the end, for prefix(size)
+    tree.assign(size / 64, 0);
+    for (int slot = 0; slot < live; slot++) {
+        slot_of[order[slot]] = slot;
+        marks[slot / 64] |= 1ULL << (slot % 64);
+    }
+    // built in place, a node passes its count on to its parent
+    for (int word = 0; word < (int)tree.size(); word++) {
+        tree[word] += __builtin_popcountll(marks[word]);
+        int parent = (word + 1) + ((word + 1) & -(word + 1));
+        if(parent <= (int)tree.size())
+            tree[parent - 1] += tree[word];
+    }
+    next_slot = live;
+}
+
+int stack_distance::access(int page)
+{
+    if(next_slot == slots)
+        compact();
+    accesses++;
+    int distance = -1;
+    if(page == (int)slot_of.size()) {
+        slot_of.push_back(-1);
+        cold++;
+    }
+    else {
+        // every page has one marked slot, the ones after last are the pages used since
+        int last = slot_of[page];
+        distance = (int)slot_of.size() - prefix(last + 1);
+        mark(last, false);
+        if(distance >= (int)histogram.size())
+            histogram.resize(std::max((size_t)distance + 1, histogram.size() * 2), 0);
+        histogram[distance]++;
+    }
+    slot_of[page] = next_slot;
+    mark(next_slot, true);
+    next_slot++;
+    return distance;
+}
+
+long stack_distance::lru_faults(int frames) const
+{
+    long faults = cold;
+    for (size_t distance = std::max(frames, 0); distance < histogram.size(); distance++)
+        faults += histogram[distance];
+    return faults;
+}
+
+void next_uses(std::vector<uint32_t>& references, int num_pages)
+{
+    std::vector<uint32_t> next(num_pages, OPT_NEVER);
+    for (size_t i = references.size(); i-- > 0; ) {
+        uint32_t page = references[i];
+        references[i] = next[page];
+        next[page] = (uint32_t)i;
+    }
+}
+
+// the resident pages are kept as the positions of their next accesses in a max-heap. a hit leaves
+// the position it was found by behind, stale since it's in the past, so stale entries are never on
+// top while a live one is and are swept out once there are as many as frames
+long opt_faults(const std::vector<uint32_t>& next_use, int frames)
+{
+    if(frames <= 0)
+        return (long)next_use.size();
+    std::vector<bool> resident(next_use.size(), false); // the page accessed at i is in memory
+    std::vector<uint32_t> heap;
+    heap.reserve(2 * (size_t)frames + 1);
+    int live = 0;
+    int stale = 0;
+    long faults = 0;
+    for (size_t i = 0; i < next_use.size(); i++) {
+        if(resident[i]) {
+            stale++;
+        }
+        else {
+            faults++;
+            if(live == frames) {
+                std::pop_heap(heap.begin(), heap.end());
+                if(heap.back() != OPT_NEVER)
+                    resident[heap.back()] = false;
+                heap.pop_back();
+                live--;
+            }
+            live++;
+        }
+        if(next_use[i] != OPT_NEVER)
+            resident[next_use[i]] = true;
+        heap.push_back(next_use[i]);
+        std::push_heap(heap.begin(), heap.end());
+        if(stale > frames) {
+            heap.erase(std::remove_if(heap.begin(), heap.end(), [i](uint32_t next) { return next <= i; }),
+                       heap.end());
+            std::make_heap(heap.begin(), heap.end());
+            stale = 0;
+        }
+    }
+    return faults;
+}
@@ -0,0 +1,62 @@
+#ifndef OS_EX4_REUSE_ANALYSIS_H
+#define OS_EX4_REUSE_ANALYSIS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// offline analysis of a page reference string, pages numbered 0, 1, 2... in order of first use
+
+// LRU stack distances in one pass (Mattson et al.). an access's distance is the number of
+// distinct other pages referenced since the last access to its page, LRU hits it in any memory
+// of more frames than that, so one histogram of distances gives the faults of every memory size.
+// each page's last access marks a slot in a bitmap counted by a Fenwick tree, the distance is the
+// count of marks after it: O(log pages) per access, memory grows with the distinct pages, not the accesses
+class stack_distance {
+    std::vector<uint64_t> marks;    // a bit per slot, set where a page's last access sits
+    std::vector<int> tree;          // Fenwick tree of the marks in each word, small enough to stay in cache
+    std::vector<int> slot_of;       // page -> slot of its last access
+    std::vector<long> histogram;    // accesses by distance
+    long cold;                      // first accesses, faults at every size
+    long accesses;
+    int slots;
+    int next_slot;
+
+    void mark(int slot, bool set) {
+        marks[slot / 64] ^= 1ULL << (slot % 64);
+        for (int i = slot / 64 + 1; i <= (int)tree.size(); i += i & -i)
+            tree[i - 1] += set ? 1 : -1;
+    }
+    int prefix(int slot) const { // marks in [0, slot)
+        int sum = __builtin_popcountll(marks[slot / 64] & ((1ULL << (slot % 64)) - 1));
+        for (int i = slot / 64; i > 0; i -= i & -i)
+            sum += tree[i - 1];
+        return sum;
+    }
+    void compact();
+
+public:
+    stack_distance();
+
+    // the distance of an access to page, -1 on its first one. a first access is to the page
+    // after the last one seen
+    int access(int page);
+    // faults of an LRU memory of frames frames
+    long lru_faults(int frames) const;
+    long cold_misses() const { return cold; }
+    long total() const { return accesses; }
+    int pages() const { return (int)slot_of.size(); }
+};
+
+// Belady's MIN: with memory full, a fault evicts the resident page whose next access is furthest
+// away, no policy faults less. it needs the whole reference string ahead, kept as next-use
+// positions: 4 bytes an access
+#define OPT_NEVER UINT32_MAX
+
+// turns a reference string into next-use positions in place: the position of the next access to
+// the same page, OPT_NEVER after its last one. num_pages is one more than the largest page
+void next_uses(std::vector<uint32_t>& references, int num_pages);
+// faults of a memory of frames frames under MIN, from next_uses' output
+long opt_faults(const std::vector<uint32_t>& next_use, int frames);
+
+#endif //OS_EX4_REUSE_ANALYSIS_H
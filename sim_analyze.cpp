@@ -0,0 +1,180 @@
+// offline analysis of an access trace (see trace.h): the faults of an LRU memory at every size,
+// from one pass of stack distances, and Belady's OPT faults at the same sizes as a lower bound.
+// addresses go through the same translation as sim_mem, and accesses sim_mem rejects with ERR
+// (bad addresses, stores to text, loads of heap pages never stored) are skipped the same way, so
+// the LRU column matches sim_replay --policy lru at that memory size.
+//
+//   sim_analyze [options] <trace>
+#include "reuse_analysis.h"
+#include "sim_mem.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options] <trace>\n"
+            "  --text/--data/--bss/--heap BYTES   segment sizes (default 1024 each)\n"
+            "  --page BYTES         page size (default 16)\n"
+            "  --address-bits N     virtual address width (default %d)\n"
+            "  --frames N,N,...     memory sizes in frames (default powers of two up to the pages touched)\n"
+            "  --no-opt             LRU only, OPT keeps 4 bytes per access in memory\n"
+            "  --csv                a CSV table only\n"
+            "  --reader mmap|read   how the trace is streamed (default mmap)\n",
+            program, ADDRESS_SIZE);
+}
+
+int main(int argc, char** argv) {
+    int sizes[NUM_OF_SEGMENTS] = {1024, 1024, 1024, 1024};
+    int page_size = 16;
+    int address_size = ADDRESS_SIZE;
+    const char* frame_list = nullptr;
+    bool with_opt = true;
+    bool csv = false;
+    trace_io reader_io = TRACE_MMAP;
+
+    static const struct option options[] = {
+            {"text", required_argument, nullptr, 'T'},
+            {"data", required_argument, nullptr, 'D'},
+            {"bss", required_argument, nullptr, 'B'},
+            {"heap", required_argument, nullptr, 'H'},
+            {"page", required_argument, nullptr, 'p'},
+            {"address-bits", required_argument, nullptr, 'a'},
+            {"frames", required_argument, nullptr, 'f'},
+            {"no-opt", no_argument, nullptr, 'n'},
+            {"csv", no_argument, nullptr, 'c'},
+            {"reader", required_argument, nullptr, 'r'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (option) {
+            case 'T': sizes[TEXT_SEGMENT] = atoi(optarg); break;
+            case 'D': sizes[DATA_SEGMENT] = atoi(optarg); break;
+            case 'B': sizes[BSS_SEGMENT] = atoi(optarg); break;
+            case 'H': sizes[HEAP_STACK_SEGMENT] = atoi(optarg); break;
+            case 'p': page_size = atoi(optarg); break;
+            case 'a': address_size = atoi(optarg); break;
+            case 'f': frame_list = optarg; break;
+            case 'n': with_opt = false; break;
+            case 'c': csv = true; break;
+            case 'r': reader_io = strcmp(optarg, "read") == 0 ? TRACE_READ : TRACE_MMAP; break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if(optind != argc - 1 || page_size <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* trace_path = argv[optind];
+    trace_reader reader;
+    if(!reader.open(trace_path, reader_io)) {
+        fprintf(stderr, "ERR: can't read trace %s\n", trace_path);
+        return 1;
+    }
+
+    sim_config defaults;
+    address_translator translator;
+    translator.init(page_size, address_size, defaults.segment_bits);
+    int seg_pages[NUM_OF_SEGMENTS], page_base[NUM_OF_SEGMENTS];
+    int total_pages = 0;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        seg_pages[seg] = sizes[seg] / page_size;
+        page_base[seg] = total_pages;
+        total_pages += seg_pages[seg];
+    }
+    // pages get dense ids in order of first use, the analysis grows with the pages touched
+    std::vector<int> id_of(total_pages, -1);
+    std::vector<bool> heap_stored(seg_pages[HEAP_STACK_SEGMENT], false);
+    stack_distance lru;
+    std::vector<uint32_t> references;
+
+    trace_record record;
+    long records = 0, skipped = 0;
+    while (reader.next(&record)) {
+        records++;
+        int offset, out;
+        uint64_t in;
+        translator.translate(record.address, &offset, &in, &out);
+        bool store = record.op == TRACE_STORE;
+        if(record.address > translator.address_mask || out >= NUM_OF_SEGMENTS || in >= (uint64_t)seg_pages[out] ||
+           (store && out == TEXT_SEGMENT)) {
+            skipped++;
+            continue;
+        }
+        if(out == HEAP_STACK_SEGMENT) {
+            if(!store && !heap_stored[in]) {
+                skipped++;
+                continue;
+            }
+            heap_stored[in] = true;
+        }
+        int &id = id_of[page_base[out] + (int)in];
+        if(id < 0)
+            id = lru.pages();
+        lru.access(id);
+        if(with_opt) {
+            if(references.size() == OPT_NEVER) {
+                fprintf(stderr, "ERR: OPT handles up to %u accesses, use --no-opt\n", OPT_NEVER - 1);
+                return 1;
+            }
+            references.push_back((uint32_t)id);
+        }
+    }
+    if(reader.failed()) {
+        fprintf(stderr, "ERR: malformed record %ld in %s\n", records + 1, trace_path);
+        return 1;
+    }
+
+    std::vector<int> frames;
+    if(frame_list != nullptr) {
+        for (const char* next = frame_list; *next != '\0'; ) {
+            char* end;
+            long count = strtol(next, &end, 10);
+            if(end == next || count <= 0) {
+                fprintf(stderr, "ERR: bad frame count in %s\n", frame_list);
+                return 1;
+            }
+            frames.push_back((int)count);
+            next = *end == ',' ? end + 1 : end;
+        }
+    }
+    else {
+        for (int count = 1; count < lru.pages(); count *= 2)
+            frames.push_back(count);
+        frames.push_back(std::max(1, lru.pages()));
+    }
+    if(with_opt)
+        next_uses(references, lru.pages());
+
+    if(!csv) {
+        printf("trace        %s (%s)\n", trace_path, reader.format() == TRACE_BINARY ? "binary" : "text");
+        printf("accesses     %ld (%ld skipped as ERR)\n", lru.total(), skipped);
+        printf("pages        %d touched, %d bytes each\n", lru.pages(), page_size);
+        printf("\n%10s %12s %14s %10s %14s %10s\n", "frames", "memory", "lru_faults", "lru_ratio", "opt_faults",
+               "opt_ratio");
+    }
+    else {
+        printf("frames,memory_bytes,lru_faults,lru_miss_ratio,opt_faults,opt_miss_ratio\n");
+    }
+    long total = std::max(1L, lru.total());
+    for (int count : frames) {
+        long lru_faults = lru.lru_faults(count);
+        long opt = with_opt ? opt_faults(references, count) : -1;
+        long long memory = (long long)count * page_size;
+        if(csv)
+            printf("%d,%lld,%ld,%.6f,%ld,%.6f\n", count, memory, lru_faults, (double)lru_faults / total, opt,
+                   with_opt ? (double)opt / total : -1.0);
+        else
+            printf("%10d %12lld %14ld %10.4f %14ld %10.4f\n", count, memory, lru_faults, (double)lru_faults / total,
+                   opt, with_opt ? (double)opt / total : -1.0);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -1,48 +1,264 @@
 #include "sim_mem.h"
 
-// a function which checks if there's an available frame in the ram which isn't used (using the memory array)
-int isMemoryAvailable(bool* memoryAllocation, int size) {
-    for (int i = 0; i < size; ++i) {
-        if(memoryAllocation[i] == false)
-            return i;
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+// picks a free swap slot for a page. with clustering the search starts at the page's home slot
+// (its position among the non-text pages) so a segment's pages sit together in the file
+int sim_mem::allocateSwapSlot(int out, int in)
+{
+    std::unique_lock<std::mutex> held = holdSwap();
+    bitmap_allocator *swap_slots = memory->swap_slots;
+    int slot;
+    if(memory->swap_clustering)
+        slot = swap_slots->allocate_from(swap_base + pageKey(out, in) - page_base[DATA_SEGMENT]);
+    else
+        slot = swap_slots->allocate();
+    int used = swap_slots->capacity() - swap_slots->available();
+    if(used > memory->swap_peak)
+        memory->swap_peak = used;
+    return slot;
+}
+
+// writes a resident page to a free slot of the swap, after which it's clean: it keeps the slot
+// and can leave its frame without another write until a store dirties it again
+void sim_mem::copyToSwap(int out, int in)
+{
+    // the swap has a slot for every non-text page and a page holds at most one, so this can't
+    // run out unless the page table is corrupted
+    int slot = allocateSwapSlot(out, in);
+    if(slot == -1) {
+        cout << "ERR" << endl;
+        exit(1);
     }
-    // If we haven't returned by now, there aren't enough free pages
-    return -1;
+    page_descriptor &page = page_table[out][in];
+    writeSwap(frameAddress(page.frame), slot);
+    counters.swap_out(out, page_size);
+    // stores through the TLB skip the page table while the entry says dirty
+    if(tlb_shift >= 0)
+        tlb.invalidate(pageNumber(out, in));
+    page.swap_index = slot;
+    page.in_swap = true;
+    page.dirty = false;
 }
 
-// moves to swap in the next swap point, once we get to the maximum pointer, we reset the pointer
-// back to the beginning
-void move_to_swap(int swapfile_fd, int* swap_pointer, page_descriptor** page_table,
-                  int out, int in,
-                  int page_size, int bss_size, int data_size, int heap_stack_size)
+// moves a page to a free slot of the swap
+void sim_mem::move_to_swap(int out, int in)
 {
-    if(*swap_pointer >= (bss_size + data_size + heap_stack_size)/page_size)
-        *swap_pointer = 0;
-    lseek(swapfile_fd, (*swap_pointer) * page_size, SEEK_SET);
-    write(swapfile_fd, &main_memory[page_table[out][in].frame * page_size], page_size);
-    page_table[out][in].swap_index = *swap_pointer;
+    copyToSwap(out, in);
     page_table[out][in].valid = false;
-    (*swap_pointer)++;
 }
 
-// parses the address we receive into segment, page, offset
-void parseAddress(int address, int size, int* offset, int* in, int* out)
+// a store makes the page differ from its swap copy, the slot is given back right away with no
+// I/O and the next eviction writes the page to a fresh one. a segment's large page has one dirty
+// bit, a store to it dirties all of its pages
+void sim_mem::markDirty(int out, int in)
+{
+    int first = in, count = 1;
+    if(large_pages && large_order[out] > 0) {
+        count = 1 << large_order[out];
+        first = in & ~(count - 1);
+    }
+    for (int i = first; i < first + count; i++) {
+        page_descriptor &page = page_table[out][i];
+        if(page.in_swap) {
+            std::unique_lock<std::mutex> held = holdSwap();
+            memory->releaseSlot(page.swap_index);
+            page.in_swap = false;
+            page.swap_index = -1;
+        }
+        page.dirty = true;
+    }
+}
+
+// puts a resident page in the TLB, with its current dirty bit. a large page gets one entry for
+// all of its pages, stores skip the page table once every one of them is dirty
+void sim_mem::cacheTranslation(int out, int in)
+{
+    if(tlb_shift < 0)
+        return;
+    page_descriptor &page = page_table[out][in];
+    if(large_pages && frame_order[page.frame] > 0) {
+        int order = frame_order[page.frame];
+        int first = in & ~((1 << order) - 1);
+        int frame = firstFrame(page.frame);
+        bool dirty = page.dirty;
+        for (int i = first; i < first + (1 << order) && dirty && large_order[out] == 0; i++)
+            dirty = page_table[out][i].dirty;
+        tlb.insert(pageNumber(out, first), frameAddress(frame), frame, out, dirty, order);
+        return;
+    }
+    tlb.insert(pageNumber(out, in), frameAddress(page.frame), page.frame, out, page.dirty);
+}
+
+sim_stats sim_mem::stats()
+{
+    sim_stats snapshot = counters.copy();
+    // in concurrent mode accesses and hits are counted in the page stripes
+    if(concurrent) {
+        for (int i = 0; i < PAGE_STRIPES; i++) {
+            std::lock_guard<std::mutex> held(stripes[i].lock);
+            snapshot.accesses += stripes[i].accesses;
+            for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++)
+                snapshot.segments[seg].hits += stripes[i].hits[seg];
+        }
+    }
+    return snapshot;
+}
+
+void sim_mem::print_stats(FILE* out, stats_format format)
+{
+    write_stats_header(out, format);
+    write_stats(out, stats(), format);
+}
+
+// periodic snapshot, the CSV header went out when the file was opened
+void sim_mem::emitStats()
+{
+    write_stats(stats_file, counters.snapshot(), stats_output_format);
+    stats_next += stats_interval;
+}
+
+tlb_usage sim_mem::tlb_stats()
+{
+    tlb_usage usage;
+    usage.entries = tlb.capacity();
+    usage.ways = tlb.associativity();
+    usage.hits = tlb.hit_count();
+    usage.misses = tlb.miss_count();
+    return usage;
+}
+
+// slot occupancy of the whole swap, shared with any other address space in the memory
+swap_usage sim_mem::swap_slot_usage()
+{
+    std::unique_lock<std::mutex> held = holdSwap();
+    return memory->swap_slot_usage();
+}
+
+// the compressed swap pool, shared with any other address space in the memory
+zswap_usage sim_mem::zswap_stats()
+{
+    std::unique_lock<std::mutex> held = holdSwap();
+    return memory->zswap_stats();
+}
+
+// pages this address space has in memory, counted over the page table
+rss_usage sim_mem::rss()
+{
+    rss_usage usage;
+    usage.resident = 0;
+    usage.shared = 0;
+    page_table.for_each([&](int, int, page_descriptor &page) {
+        if(!page.valid)
+            return;
+        usage.resident++;
+        if(frames[page.frame].mappers > 1)
+            usage.shared++;
+    });
+    usage.peak_resident = std::max(peak_resident, usage.resident);
+    usage.owned_frames = owned_frames;
+    usage.frame_quota = frame_quota;
+    return usage;
+}
+
+// reads a swap slot, from the compressed pool when it has it, otherwise through the write-back
+// buffer when swap I/O is asynchronous. from_disk tells whether the file was read or the pool or
+// async swap still had the slot in memory
+ssize_t sim_mem::readSwap(char* dst, int slot, bool* from_disk)
 {
-    bitset<ADDRESS_SIZE> binaryNumber(address);
-    string binary = binaryNumber.to_string();
+    *from_disk = true;
+    compressed_swap *zswap = memory->zswap;
+    if(zswap != nullptr) { // a pool hit never reaches the file
+        std::unique_lock<std::mutex> held = holdSwap();
+        if(zswap->load(slot, dst)) {
+            *from_disk = false;
+            return page_size;
+        }
+    }
+    if(concurrent)
+        __atomic_fetch_add(&memory->swap_reads, 1, __ATOMIC_RELAXED);
+    else
+        memory->swap_reads++;
+    async_swap *swap_async = memory->swap_async;
+    if(swap_async != nullptr) {
+        std::unique_lock<std::mutex> held = holdSwap();
+        long disk_reads = swap_async->counts().pages_read;
+        ssize_t result = swap_async->read_page(slot, dst);
+        *from_disk = swap_async->counts().pages_read != disk_reads;
+        return result;
+    }
+    return memory->swap_file.read(dst, (off_t)slot * page_size, page_size);
+}
 
-    // grabbing the first two most significant digits from the address string
-    // converting the string to an int and converting from binary to decimal
-    bitset<ADDRESS_SIZE> BinaryIn(binary.substr(0, 2));
-    *out = BinaryIn.to_ulong();
+// a run of count free swap slots for a large page, -1 if the free slots are too scattered
+int sim_mem::allocateSwapRun(int count)
+{
+    bitmap_allocator *swap_slots = memory->swap_slots;
+    int slot = swap_slots->allocate_run(count);
+    int used = swap_slots->capacity() - swap_slots->available();
+    if(used > memory->swap_peak)
+        memory->swap_peak = used;
+    return slot;
+}
 
-    int log2result = log(size) / log(2);
+// writes a swap slot, into the compressed pool when it's on and takes the page. the pool's
+// oldest pages go on to the file when it grows past its budget
+ssize_t sim_mem::writeSwap(const char* src, int slot)
+{
+    compressed_swap *zswap = memory->zswap;
+    if(zswap == nullptr)
+        return writeSwapFile(src, slot);
+    std::unique_lock<std::mutex> held = holdSwap();
+    if(!zswap->store(slot, src))
+        return writeSwapFile(src, slot);
+    const char* spilled_page;
+    int spilled;
+    while ((spilled = zswap->spill(&spilled_page)) != -1) {
+        if(writeSwapFile(spilled_page, spilled) != page_size) {
+            perror("ERR");
+            exit(1);
+        }
+    }
+    return page_size;
+}
+
+// writes a swap slot to the file, through the write-back buffer when swap I/O is asynchronous.
+// concurrent callers hold the swap lock when the pool is on
+ssize_t sim_mem::writeSwapFile(const char* src, int slot)
+{
+    if(concurrent)
+        __atomic_fetch_add(&memory->swap_writes, 1, __ATOMIC_RELAXED);
+    else
+        memory->swap_writes++;
+    if(memory->swap_async != nullptr) {
+        std::unique_lock<std::mutex> held;
+        if(memory->zswap == nullptr)
+            held = holdSwap();
+        memory->swap_async->write_page(slot, src);
+        return page_size;
+    }
+    return memory->swap_file.write(src, (off_t)slot * page_size, page_size);
+}
 
-    bitset<ADDRESS_SIZE> BinaryOffset(binary.substr(12-log2result, ADDRESS_SIZE));
-    *offset = BinaryOffset.to_ulong() % size;
+// precomputes the shifts and masks parseAddress uses, the top segment_bits bits of the address
+// select the segment and the rest is the byte position inside that segment
+void address_translator::init(int page_size, int address_size, int segment_bits) {
+    this->page_size = page_size;
+    address_mask = address_size >= 64 ? ~0ULL : (1ULL << address_size) - 1;
+    segment_shift = address_size - segment_bits;
+    in_mask = (1ULL << segment_shift) - 1;
 
-    bitset<ADDRESS_SIZE> BinaryOut(binary.substr(2, 12));
-    *in = BinaryOut.to_ulong() / size;
+    page_shift = -1;
+    offset_mask = 0;
+    if(page_size > 0 && (page_size & (page_size - 1)) == 0) {
+        page_shift = __builtin_ctz(page_size);
+        offset_mask = page_size - 1;
+    }
 }
 
 // buffer to know from where to read in exec in exec
@@ -76,31 +292,477 @@ int sim_mem::numOfPages(int segment) {
     return -1;
 }
 
-// checks which is the least recently used page and switches it up and returns its info
+// records the owner of a freshly loaded frame and hands it to the replacement policy
+void sim_mem::trackFrame(int frame, int segment, int page) {
+    frames[frame].owner = this;
+    frames[frame].segment = segment;
+    frames[frame].page = page;
+    frames[frame].mappers = 1;
+    countResident(1);
+    if(concurrent) {
+        frame_referenced[frame].store(1, std::memory_order_relaxed);
+        frame_owner[frame].store(pageKey(segment, page), std::memory_order_release);
+        return;
+    }
+    owned_frames++;
+    // the next address space faulting on this text page maps the frame instead of reading it
+    if(segment == TEXT_SEGMENT && share_text)
+        memory->text_frames[physical_memory::textKey(exec_id, page)] = frame;
+    policy->on_insert(frame, key_base + pageKey(segment, page));
+}
+
+void sim_mem::countResident(int delta) {
+    int now;
+    if(concurrent)
+        now = __atomic_add_fetch(&resident_pages, delta, __ATOMIC_RELAXED);
+    else
+        now = resident_pages += delta;
+    if(now > (concurrent ? __atomic_load_n(&peak_resident, __ATOMIC_RELAXED) : peak_resident))
+        __atomic_store_n(&peak_resident, now, __ATOMIC_RELAXED);
+}
+
+// takes a resident page out of its frame for the replacement policy, backed up in the swap
+// first if it's dirty. the frame is left to the caller. a segment's large page goes as a whole,
+// a promoted one is split and just its first page goes
+void sim_mem::evictResident(int out, int in) {
+    page_descriptor &page = page_table[out][in];
+    if(large_pages && frame_order[page.frame] > 0) {
+        if(large_order[out] > 0) {
+            evictLarge(out, in);
+            return;
+        }
+        demote(out, in);
+    }
+    // a stale TLB entry would point into someone else's page
+    if(tlb_shift >= 0)
+        tlb.invalidate(pageNumber(out, in));
+    // text is never dirty, it's read again from the exec file when needed
+    bool dirty = page.dirty && out != TEXT_SEGMENT;
+    counters.eviction(out, dirty);
+    if(dirty)
+        move_to_swap(out, in);
+    // read ahead for nothing, the segment's next windows get smaller
+    if(page.prefetched) {
+        page.prefetched = false;
+        counters.prefetch_waste(out);
+        readahead[out].size = std::max(std::min(READAHEAD_MIN, readahead_max), readahead[out].size / 2);
+    }
+    page.valid = false;
+    page.frame = -1;
+    owned_frames--;
+    countResident(-1);
+}
+
+// evicts the large page starting at page first, dirty ones are written to a run of swap slots
+// with one write. its first frame is left to the caller, the others are freed
+void sim_mem::evictLarge(int out, int first) {
+    int count = 1 << large_order[out];
+    page_descriptor &head = page_table[out][first];
+    int frame = head.frame;
+    if(tlb_shift >= 0)
+        tlb.invalidate(pageNumber(out, first), large_order[out]);
+    bool dirty = head.dirty && out != TEXT_SEGMENT;
+    counters.eviction(out, dirty);
+    if(dirty) {
+        // the compressed pool and async swap take one page at a time
+        int slot = memory->zswap == nullptr && memory->swap_async == nullptr ? allocateSwapRun(count) : -1;
+        if(slot == -1) {
+            for (int i = 0; i < count; i++)
+                move_to_swap(out, first + i);
+        }
+        else {
+            memory->swap_writes++;
+            memory->swap_file.write(frameAddress(frame), (off_t)slot * page_size, (size_t)count * page_size);
+            counters.swap_out(out, (long)count * page_size);
+            counters.large_io(out, count);
+            for (int i = 0; i < count; i++) {
+                page_descriptor &page = page_table[out][first + i];
+                page.swap_index = slot + i;
+                page.in_swap = true;
+                page.dirty = false;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        page_descriptor &page = page_table[out][first + i];
+        page.valid = false;
+        page.frame = -1;
+        frame_order[frame + i] = 0;
+        if(i > 0) {
+            frames[frame + i].owner = nullptr;
+            frames[frame + i].mappers = 0;
+            memory->free_frames->release(frame + i);
+        }
+    }
+    owned_frames -= count;
+    countResident(-count);
+}
+
+// splits the promoted large page starting at page first back into base pages, the ones after
+// the first go back to the policy as if they had just been loaded
+void sim_mem::demote(int out, int first) {
+    int frame = page_table[out][first].frame;
+    int order = frame_order[frame];
+    if(tlb_shift >= 0)
+        tlb.invalidate(pageNumber(out, first), order);
+    for (int i = 0; i < (1 << order); i++) {
+        frame_order[frame + i] = 0;
+        if(i > 0) {
+            policy->on_fault(key_base + pageKey(out, first + i));
+            policy->on_insert(frame + i, key_base + pageKey(out, first + i));
+        }
+    }
+    counters.demotion(out);
+}
+
+// the shared text frame is being reclaimed, drops this address space's mapping of it if it has one
+void sim_mem::unmapShared(int frame, int page) {
+    if(page >= seg_pages[TEXT_SEGMENT] || !mapsFrame(page, frame))
+        return;
+    if(tlb_shift >= 0)
+        tlb.invalidate(pageNumber(TEXT_SEGMENT, page));
+    counters.eviction(TEXT_SEGMENT, false);
+    page_descriptor &descriptor = page_table[TEXT_SEGMENT][page];
+    descriptor.valid = false;
+    descriptor.frame = -1;
+    countResident(-1);
+}
+
+void sim_mem::keyToPage(int key, int* out, int* in) const {
+    int seg = 0;
+    while (key >= page_base[seg] + seg_pages[seg])
+        seg++;
+    *out = seg;
+    *in = key - page_base[seg];
+}
+
+static std::atomic<unsigned> next_thread_slot{0};
+
+// concurrent mode: a frame for a page of segment in own_stripe, whose lock the caller holds. a
+// free frame comes from the lock-free pool, otherwise the fault reclaims one itself
+int sim_mem::claimFrame(int own_stripe, int segment) {
+    int frame = frame_pool->allocate();
+    if(frame != -1) {
+        wakePageOut();
+        return frame;
+    }
+    counters.direct_reclaim(segment);
+    wakePageOut();
+    return sweepClock(own_stripe);
+}
+
+// the sharded CLOCK evicts a victim and returns its frame, marked FRAME_BUSY. a thread sweeps
+// the hand of its own shard, clears reference bits on the way and skips frames being filled.
+// the victim's stripe is only try_locked, so faulting threads never wait on each other (and
+// never deadlock), a busy stripe just means the hand moves on. own_stripe is -1 for the
+// page-out daemon, which holds no stripe, starts each sweep at the next shard so its evictions
+// spread over all of memory, and gives up with -1 after trying every shard
+int sim_mem::sweepClock(int own_stripe) {
+    static thread_local unsigned thread_slot = next_thread_slot++;
+    int shard = own_stripe < 0 ? pageout_shard++ % num_shards : thread_slot % num_shards;
+    long swept = 0, shards_tried = 0;
+    while (true) {
+        clock_shard &clock = clock_shards[shard];
+        // two turns of a shard without a victim, move to the next one
+        if(++swept > 2L * clock.count) {
+            swept = 0;
+            shard = (shard + 1) % num_shards;
+            if(++shards_tried % num_shards == 0) {
+                if(own_stripe < 0)
+                    return -1;
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        int candidate = clock.first + (int)(clock.hand.fetch_add(1, std::memory_order_relaxed) % clock.count);
+        int key = frame_owner[candidate].load(std::memory_order_acquire);
+        if(key < 0)
+            continue;
+        if(frame_referenced[candidate].load(std::memory_order_relaxed)) {
+            frame_referenced[candidate].store(0, std::memory_order_relaxed);
+            continue;
+        }
+        int stripe = key & (PAGE_STRIPES - 1);
+        if(stripe != own_stripe && !stripes[stripe].lock.try_lock())
+            continue;
+        int outter, inner;
+        keyToPage(key, &outter, &inner);
+        page_descriptor &victim = page_table[outter][inner];
+        // the frame may have changed hands between reading its owner and taking the lock
+        bool claimed = victim.valid && victim.frame == candidate &&
+                frame_owner[candidate].compare_exchange_strong(key, FRAME_BUSY, std::memory_order_acq_rel);
+        if(claimed) {
+            bool dirty = victim.dirty && outter != TEXT_SEGMENT;
+            counters.eviction(outter, dirty);
+            if(own_stripe < 0)
+                counters.background_reclaim(outter);
+            if(dirty)
+                move_to_swap(outter, inner);
+            victim.valid = false;
+            victim.frame = -1;
+            countResident(-1);
+        }
+        if(stripe != own_stripe)
+            stripes[stripe].lock.unlock();
+        if(claimed)
+            return candidate;
+    }
+}
+
+// returns a frame to load a page into: a free one if there is any, otherwise the frame of the
+// page the replacement policy evicts (backed up in the swap first if it's dirty)
+int sim_mem::acquireFrame() {
+    int frame = -1;
+    // under local replacement an address space at its quota replaces one of its own pages
+    if(frame_quota == 0 || owned_frames < frame_quota)
+        frame = memory->free_frames->allocate();
+    if(frame != -1)
+        return frame;
+
+    int outter = 0, inner = 0;
+    direct_reclaim = true;
+    frame = evictPage(&outter, &inner);
+    // whichever address spaces map the victim let go of it
+    memory->reclaimFrame(frame);
+    // the frame stays allocated, it goes straight to the faulting page
+    return frame;
+}
+
+// a free aligned block of 2^order frames for a large page. with none, the policy's victim is
+// evicted together with every other page in the block it sits in (lumpy reclaim) until one is
+int sim_mem::acquireBlock(int order) {
+    int count = 1 << order;
+    bitmap_allocator *free_frames = memory->free_frames;
+    while (true) {
+        int block = -1;
+        if(frame_quota == 0 || owned_frames + count <= frame_quota)
+            block = free_frames->allocate_aligned(count);
+        if(block != -1)
+            return block;
+        direct_reclaim = true;
+        int victim = policy->select_victim();
+        memory->reclaimFrame(victim);
+        free_frames->release(victim);
+        block = victim & ~(count - 1);
+        for (int frame = block; frame < block + count && block + count <= num_frames; frame++) {
+            // the rest of a large page went with its first frame
+            if(free_frames->is_free(frame) || firstFrame(frame) != frame)
+                continue;
+            policy->on_remove(frame);
+            memory->reclaimFrame(frame);
+            free_frames->release(frame);
+        }
+    }
+}
+
+// with promotion on, a frame for a base page at its place in an aligned block of frames for its
+// group: next to the group's resident pages, or in a free block when none is. a full group is
+// then promoted without copying. -1 when that frame is taken
+int sim_mem::groupFrame(int out, int in) {
+    int count = 1 << promote_order;
+    int first = in & ~(count - 1);
+    bitmap_allocator *free_frames = memory->free_frames;
+    if(first + count > seg_pages[out] || (frame_quota > 0 && owned_frames >= frame_quota))
+        return -1;
+    for (int page = first; page < first + count; page++) {
+        const page_descriptor* sibling = page_table.find(out, page);
+        if(sibling == nullptr || !sibling->valid)
+            continue;
+        int block = sibling->frame - (page - first);
+        if(block < 0 || block % count != 0 || block + count > num_frames || !free_frames->claim(block + in - first))
+            return -1;
+        return block + in - first;
+    }
+    int block = free_frames->available() >= count ? free_frames->allocate_aligned(count) : -1;
+    if(block == -1)
+        return -1;
+    for (int frame = block; frame < block + count; frame++) {
+        if(frame != block + in - first)
+            free_frames->release(frame);
+    }
+    return block + in - first;
+}
+
+// promotion: each group of 2^promote_order pages from `from` to `to` that is all resident becomes
+// a large page. in place when its frames are an aligned block already, otherwise it's copied to
+// a free one, and left alone when there is none
+void sim_mem::promoteGroups(int out, int from, int to) {
+    int count = 1 << promote_order;
+    bitmap_allocator *free_frames = memory->free_frames;
+    for (int first = from & ~(count - 1); first <= to && first + count <= seg_pages[out]; first += count) {
+        bool resident = true, in_place = true;
+        int block = -1;
+        for (int i = 0; i < count && resident; i++) {
+            const page_descriptor* page = page_table.find(out, first + i);
+            resident = page != nullptr && page->valid && frame_order[page->frame] == 0;
+            if(resident && i == 0)
+                block = page->frame;
+            in_place = in_place && resident && page->frame == block + i;
+        }
+        if(!resident)
+            continue;
+        if(!in_place || block % count != 0) {
+            block = free_frames->available() >= count ? free_frames->allocate_aligned(count) : -1;
+            if(block == -1)
+                continue;
+            for (int i = 0; i < count; i++) {
+                page_descriptor &page = page_table[out][first + i];
+                memcpy(frameAddress(block + i), frameAddress(page.frame), page_size);
+                frames[block + i] = frames[page.frame];
+                frames[page.frame].owner = nullptr;
+                frames[page.frame].mappers = 0;
+                policy->on_remove(page.frame);
+                free_frames->release(page.frame);
+                page.frame = block + i;
+            }
+            policy->on_fault(key_base + pageKey(out, first));
+            policy->on_insert(block, key_base + pageKey(out, first));
+        }
+        else {
+            for (int i = 1; i < count; i++)
+                policy->on_remove(block + i);
+        }
+        for (int i = 0; i < count; i++) {
+            frame_order[block + i] = promote_order;
+            if(tlb_shift >= 0)
+                tlb.invalidate(pageNumber(out, first + i));
+        }
+        counters.promotion(out);
+    }
+}
+
+// asks the replacement policy for a victim and returns its info. under global replacement in a
+// shared memory the page may belong to another address space
 int sim_mem::evictPage(int* outter, int* inner) {
-    int oldestPage = INT_MAX;
-    int oldestSeg = INT_MAX;
-    int oldestAccess = INT_MAX;
+    int victim = policy->select_victim();
+    *outter = frames[victim].segment;
+    *inner = frames[victim].page;
+    return victim;
+}
 
-     // calculate the number of pages in this segment
-    for(int seg = 0; seg < 4; seg++)
-    {
-        int num_pages = numOfPages(seg);
-        for(int page = 0; page < num_pages; page++) {
-            if(page_table[seg][page].last_access < oldestAccess && page_table[seg][page].frame != -1) {
-                oldestPage = page;
-                oldestSeg = seg;
-                oldestAccess = page_table[seg][page].last_access;
+// frames a fault could take without evicting, within the frame quota under local replacement
+int sim_mem::freeFrames() const {
+    int free = memory->free_frames->available();
+    return frame_quota > 0 ? std::min(free, frame_quota - owned_frames) : free;
+}
+
+// the page-out daemon, single threaded. it runs every pageout_interval accesses, so a replay
+// does the same each time: under the low watermark the policy's victims are evicted until the
+// high one is reached, and with no more free frames than that the next victims are written back
+void sim_mem::pageOut() {
+    pageout_countdown = pageout_interval;
+    if(freeFrames() < pageout_low) {
+        // under local replacement an address space only evicts its own pages
+        while (freeFrames() < pageout_high && (frame_quota == 0 || owned_frames > 0)) {
+            int victim = policy->select_victim();
+            frames[victim].owner->counters.background_reclaim(frames[victim].segment);
+            memory->reclaimFrame(victim);
+            memory->free_frames->release(victim);
+        }
+    }
+    if(freeFrames() <= pageout_high)
+        writeBackVictims();
+}
+
+// writes the dirty pages among the next pageout_clean victims to the swap, evicting them later
+// costs the fault no write. large pages are left to go out whole when they're evicted
+void sim_mem::writeBackVictims() {
+    int found = policy->next_victims(pageout_victims.data(), pageout_clean);
+    for (int i = 0; i < found; i++) {
+        int frame = pageout_victims[i];
+        sim_mem* owner = frames[frame].owner;
+        int out = frames[frame].segment, in = frames[frame].page;
+        if(out == TEXT_SEGMENT || (owner->large_pages && owner->frame_order[frame] > 0) ||
+           !owner->page_table[out][in].dirty)
+            continue;
+        owner->copyToSwap(out, in);
+        owner->counters.writeback(out);
+    }
+}
+
+// the page-out daemon's thread in concurrent mode. it sleeps until a fault sees fewer than
+// pageout_low free frames, or for a millisecond at most, then runs
+void sim_mem::pageOutDaemon() {
+    std::unique_lock<std::mutex> held(pageout_lock);
+    while (!pageout_stop) {
+        pageout_wake.wait_for(held, std::chrono::milliseconds(1),
+                              [this] { return pageout_stop || pageout_wanted.load(); });
+        if(pageout_stop)
+            break;
+        // a fault from now on wakes it again
+        pageout_wanted.store(false);
+        held.unlock();
+        concurrentPageOut();
+        held.lock();
+    }
+}
+
+// one run of the daemon thread, pageOut over the sharded CLOCK: victims are evicted from under
+// the low watermark up to the high one, then each shard's hand is followed for the dirty frames
+// it would take next, which are written back. a stripe that is busy is skipped
+void sim_mem::concurrentPageOut() {
+    if(frame_pool->available() < pageout_low) {
+        while (frame_pool->available() < pageout_high) {
+            int frame = sweepClock(-1);
+            if(frame == -1)
+                break;
+            frame_owner[frame].store(FRAME_FREE, std::memory_order_release);
+            frame_pool->release(frame);
+        }
+    }
+    if(frame_pool->available() > pageout_high)
+        return;
+    int budget = (pageout_clean + num_shards - 1) / num_shards;
+    for (int shard = 0; shard < num_shards; shard++) {
+        clock_shard &clock = clock_shards[shard];
+        unsigned hand = clock.hand.load(std::memory_order_relaxed);
+        int cleaned = 0;
+        for (int step = 0; step < clock.count && cleaned < budget; step++) {
+            int frame = clock.first + (int)((hand + step) % clock.count);
+            int key = frame_owner[frame].load(std::memory_order_acquire);
+            if(key < 0 || frame_referenced[frame].load(std::memory_order_relaxed))
+                continue;
+            page_stripe &stripe = stripes[key & (PAGE_STRIPES - 1)];
+            if(!stripe.lock.try_lock())
+                continue;
+            int out, in;
+            keyToPage(key, &out, &in);
+            page_descriptor &page = page_table[out][in];
+            if(page.valid && page.frame == frame && page.dirty && out != TEXT_SEGMENT) {
+                copyToSwap(out, in);
+                counters.writeback(out);
+                cleaned++;
             }
+            stripe.lock.unlock();
         }
     }
-    *outter = oldestSeg;
-    *inner = oldestPage;
-    return page_table[*outter][*inner].frame;
 }
 
-// constructor
-sim_mem::sim_mem(const char* exe_file_name, const char* swap_file_name, int text_size, int data_size, int bss_size, int heap_stack_size, int page_size) {
+static sim_config config_with_policy(policy_type policy)
+{
+    sim_config config;
+    config.policy = policy;
+    return config;
+}
+
+// constructor with the default machine
+sim_mem::sim_mem(const char* exe_file_name, const char* swap_file_name, int text_size, int data_size, int bss_size, int heap_stack_size, int page_size, policy_type policy)
+    : sim_mem(exe_file_name, swap_file_name, text_size, data_size, bss_size, heap_stack_size, page_size,
+              config_with_policy(policy)) {}
+
+// constructor, the simulator gets a physical memory of its own
+sim_mem::sim_mem(const char* exe_file_name, const char* swap_file_name, int text_size, int data_size, int bss_size, int heap_stack_size, int page_size, const sim_config& config) {
+    setUp(nullptr, exe_file_name, swap_file_name, text_size, data_size, bss_size, heap_stack_size, page_size, config);
+}
+
+// constructor of an address space allocating from a shared physical memory
+sim_mem::sim_mem(physical_memory& memory, const char* exe_file_name, int text_size, int data_size, int bss_size, int heap_stack_size, const sim_config& config) {
+    setUp(&memory, exe_file_name, nullptr, text_size, data_size, bss_size, heap_stack_size, memory.page_bytes(), config);
+}
+
+// builds the address space, with shared == nullptr the physical memory (frames and the swap file
+// named swap_file_name) is created for it
+void sim_mem::setUp(physical_memory* shared, const char* exe_file_name, const char* swap_file_name, int text_size, int data_size, int bss_size, int heap_stack_size, int page_size, const sim_config& config) {
     //flushing all streams just in case
     fflush(NULL);
 
@@ -111,8 +773,22 @@ sim_mem::sim_mem(const char* exe_file_name, const char* swap_file_name, int text
     this->heap_stack_size = heap_stack_size;
     this->page_size = page_size;
 
-    for (int i = 0; i < MEMORY_SIZE; ++i) {
-        main_memory[i] = '0';
+    // the four segments need at least two selector bits, and something must be left for the pages.
+    // many threads need a physical memory no other address space touches
+    if(page_size <= 0 || config.address_size > 64 || config.segment_bits < 2
+       || config.segment_bits >= config.address_size || (shared == nullptr && config.memory_size < page_size)
+       || (shared != nullptr && config.concurrent))
+    {
+        cout << "ERR" << endl;
+        exit(1);
+    }
+    this->translator.init(page_size, config.address_size, config.segment_bits);
+    // the TLB tags pages by address >> page_shift, which needs a power of two page size no
+    // bigger than a segment (page size 1 is left out so no page number can look like EMPTY_VPN)
+    this->tlb_shift = -1;
+    if(!config.concurrent && config.tlb_entries > 0 && translator.page_shift > 0 && translator.page_shift <= translator.segment_shift) {
+        this->tlb_shift = translator.page_shift;
+        this->tlb.init(config.tlb_entries, config.tlb_ways);
     }
 
     if(exe_file_name == NULL)
@@ -122,262 +798,525 @@ sim_mem::sim_mem(const char* exe_file_name, const char* swap_file_name, int text
     }
 
 
-    this->program_fd = open(exe_file_name, O_RDONLY);
-
-    if (this->program_fd == -1) {
+    if (!this->exec_file.open(exe_file_name, O_RDONLY)) {
         cout << "ERR";
         exit(1); // terminate with error
     }
 
-    if(swap_file_name == NULL)
+    this->owns_memory = shared == nullptr;
+    if(owns_memory) {
+        if(swap_file_name == NULL)
+        {
+            cout << "ERR" << endl;
+            exit(1);
+        }
+        // the swap is as long as bss + data + heap stack
+        shared = new physical_memory(swap_file_name, page_size, (long long)bss_size + data_size + heap_stack_size, config);
+    }
+    this->memory = shared;
+    this->main_memory = memory->main_memory;
+    this->num_frames = memory->num_frames;
+    this->frames = memory->frames;
+
+    // with MMAP_IO both files are mapped once and page transfers become memcpy,
+    // if mapping isn't possible they quietly stay on the syscall path
+    if(exec_file.map(config.io, false) && config.madvise_hints)
+        exec_file.advise(MADV_WILLNEED); // read-only and small next to memory, fault it in early
+    int total_pages = 0;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        page_base[seg] = total_pages;
+        seg_pages[seg] = numOfPages(seg);
+        total_pages += seg_pages[seg];
+    }
+    // the flat layout or a radix tree; concurrent threads would race to allocate its nodes
+    if((config.concurrent && config.page_table_levels != 2) || !page_table.init(config.page_table_levels, seg_pages))
     {
         cout << "ERR" << endl;
         exit(1);
     }
 
-    int swapLength = bss_size + data_size + heap_stack_size;
+    // the address space's place in memory: its policy keys, its share of the swap and, under
+    // local replacement, its frame quota
+    this->swap_pages = total_pages - seg_pages[TEXT_SEGMENT];
+    this->frame_quota = 0;
+    if(memory->scope == LOCAL_REPLACEMENT)
+        this->frame_quota = config.frame_quota > 0 ? config.frame_quota : num_frames - memory->frames_reserved;
+    memory->attach(this, total_pages, swap_pages, frame_quota);
+    this->exec_id = -1;
+    this->share_text = !owns_memory && memory->share_text && seg_pages[TEXT_SEGMENT] > 0;
+    if(share_text)
+        this->exec_id = memory->execId(exec_file.descriptor());
+    this->foreign_frames = share_text && memory->scope == LOCAL_REPLACEMENT;
+    this->owned_frames = 0;
+    this->resident_pages = 0;
+    this->peak_resident = 0;
 
+    // the policy kind is the memory's, every address space in it tracks frames the same way
+    this->policy_kind = memory->policy_kind;
+    this->policy = memory->policy;
+    if(!config.concurrent && memory->scope == LOCAL_REPLACEMENT) {
+        this->key_base = 0;
+        this->policy = make_policy(policy_kind, num_frames, total_pages);
+    }
+    if(!config.concurrent && this->policy == nullptr)
+    {
+        cout << "ERR" << endl;
+        exit(1);
+    }
 
-    // Open the file, truncating any existing content
-    this->swapfile_fd = open(swap_file_name, O_RDWR | O_CREAT | O_TRUNC, 0666);  // Read/write permissions for owner, read permissions for others
-    if (this->swapfile_fd < 0) {
-        perror("ERR");
+    // large pages are a power of two number of base pages dividing their segment, their fault
+    // and eviction paths are single threaded and want a memory of their own that holds at least one
+    const int segment_sizes[NUM_OF_SEGMENTS] = {text_size, data_size, bss_size, heap_stack_size};
+    this->promote_order = config.promote_order;
+    this->large_pages = promote_order > 0;
+    int largest = promote_order;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        int size = config.segment_page_size[seg];
+        large_order[seg] = 0;
+        if(size != 0 && size != page_size) {
+            int pages = size / page_size;
+            if(size < page_size || size % page_size != 0 || (pages & (pages - 1)) != 0 || segment_sizes[seg] % size != 0)
+            {
+                cout << "ERR" << endl;
+                exit(1);
+            }
+            large_order[seg] = __builtin_ctz(pages);
+            large_pages = true;
+        }
+        largest = std::max(largest, large_order[seg]);
+        tlb_order[seg] = large_order[seg] > 0 ? large_order[seg] : promote_order;
+    }
+    if(large_pages && (config.concurrent || !owns_memory || promote_order < 0 || largest > 24 ||
+                       (1 << largest) > (frame_quota > 0 ? frame_quota : num_frames)))
+    {
+        cout << "ERR" << endl;
         exit(1);
     }
+    this->frame_order.assign(large_pages ? num_frames : 0, 0);
 
+    // read-ahead keeps per segment state, concurrent mode goes without it
+    this->readahead_max = config.concurrent || config.readahead_max <= 1 ? 0 : config.readahead_max;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        readahead[seg].next = -1;
+        readahead[seg].size = std::min(READAHEAD_MIN, std::max(readahead_max, 1));
+        readahead[seg].issued = 0;
+        readahead[seg].used = 0;
+    }
+    this->readahead_io.resize(std::max(readahead_max, 1));
 
-    char zero = '0';
-    // writing the 'zeros' into the file in the length of swap (bss + data + heap stack)
-    while(swapLength > 0)
+    // concurrent mode swaps the single threaded pieces (the policy, the free frame bitmap,
+    // the TLB) for striped locks, a lock-free frame pool and a sharded CLOCK
+    this->concurrent = config.concurrent;
+    this->stripes = nullptr;
+    this->frame_pool = nullptr;
+    this->frame_owner = nullptr;
+    this->frame_referenced = nullptr;
+    this->clock_shards = nullptr;
+    this->num_shards = 0;
+    if(concurrent) {
+        this->stripes = new page_stripe[PAGE_STRIPES];
+        this->frame_pool = new atomic_bitmap_allocator(num_frames);
+        this->frame_owner = new std::atomic<int>[num_frames];
+        this->frame_referenced = new std::atomic<unsigned char>[num_frames];
+        for (int i = 0; i < num_frames; i++) {
+            frame_owner[i].store(FRAME_FREE, std::memory_order_relaxed);
+            frame_referenced[i].store(0, std::memory_order_relaxed);
+        }
+        // shards of at least 64 frames, at most 16 of them
+        this->num_shards = std::max(1, std::min(16, num_frames / 64));
+        this->clock_shards = new clock_shard[num_shards];
+        for (int i = 0; i < num_shards; i++) {
+            clock_shards[i].first = (int)((long)num_frames * i / num_shards);
+            clock_shards[i].count = (int)((long)num_frames * (i + 1) / num_shards) - clock_shards[i].first;
+        }
+        counters.share(&stats_lock);
+    }
+
+    // the page-out daemon keeps a reserve of free frames, it must leave at least one for pages
+    int capacity = frame_quota > 0 ? frame_quota : num_frames;
+    this->pageout_low = config.pageout_low;
+    this->pageout_high = config.pageout_high > 0 ? config.pageout_high : 2 * config.pageout_low;
+    this->pageout_clean = config.pageout_clean;
+    this->pageout_interval = config.pageout_interval;
+    if(pageout_low < 0 || (pageout_low > 0 && (pageout_high < pageout_low || pageout_high >= capacity ||
+                                              pageout_clean < 0 || pageout_interval <= 0)))
     {
-        if (write(this->swapfile_fd, &zero, 1) != 1) {
+        cout << "ERR" << endl;
+        exit(1);
+    }
+    this->pageout_countdown = pageout_low > 0 && !concurrent ? pageout_interval : LONG_MAX;
+    this->pageout_victims.resize(std::max(pageout_clean, 1));
+    this->direct_reclaim = false;
+    this->pageout_stop = false;
+    this->pageout_shard = 0;
+
+    this->stats_file = nullptr;
+    this->stats_interval = config.stats_interval;
+    this->stats_output_format = config.stats_output_format;
+    this->stats_next = LONG_MAX;
+    // periodic snapshots count accesses on the single threaded path only
+    if(SIM_MEM_STATS && !concurrent && config.stats_interval > 0 && config.stats_output != nullptr) {
+        if(strcmp(config.stats_output, "-") == 0)
+            this->stats_file = stdout;
+        else
+            this->stats_file = fopen(config.stats_output, "w");
+        if(this->stats_file == nullptr)
+        {
             perror("ERR");
             exit(1);
         }
-        swapLength--;
-    }
-    // initiating page_table variable
-    this->page_table = new page_descriptor * [NUM_OF_SEGMENTS];
-    this->page_table[TEXT_SEGMENT] = new page_descriptor[text_size/page_size];
-    for (int i = 0; i < text_size/page_size; ++i) {
-        page_table[TEXT_SEGMENT][i].valid = false;
-        page_table[TEXT_SEGMENT][i].frame = -1;
-        page_table[TEXT_SEGMENT][i].dirty = false;
-        page_table[TEXT_SEGMENT][i].swap_index = -1;
-        page_table[TEXT_SEGMENT][i].last_access = 0;
-    }
-    this->page_table[DATA_SEGMENT] = new page_descriptor[data_size/page_size];
-    for (int i = 0; i < data_size/page_size; ++i) {
-        page_table[DATA_SEGMENT][i].valid = false;
-        page_table[DATA_SEGMENT][i].frame = -1;
-        page_table[DATA_SEGMENT][i].dirty = false;
-        page_table[DATA_SEGMENT][i].swap_index = -1;
-        page_table[DATA_SEGMENT][i].last_access = 0;
-    }
-    this->page_table[BSS_SEGMENT] = new page_descriptor[bss_size/page_size];
-    for (int i = 0; i < bss_size/page_size; ++i) {
-        page_table[BSS_SEGMENT][i].valid = false;
-        page_table[BSS_SEGMENT][i].frame = -1;
-        page_table[BSS_SEGMENT][i].dirty = false;
-        page_table[BSS_SEGMENT][i].swap_index = -1;
-        page_table[BSS_SEGMENT][i].last_access = 0;
-    }
-    this->page_table[HEAP_STACK_SEGMENT] = new page_descriptor[heap_stack_size/page_size];
-    for (int i = 0; i < heap_stack_size/page_size; ++i) {
-        page_table[HEAP_STACK_SEGMENT][i].valid = false;
-        page_table[HEAP_STACK_SEGMENT][i].frame = -1;
-        page_table[HEAP_STACK_SEGMENT][i].dirty = false;
-        page_table[HEAP_STACK_SEGMENT][i].swap_index = -1;
-        page_table[HEAP_STACK_SEGMENT][i].last_access = 0;
-    }
-
-    this->memoryAllocation = new bool[MEMORY_SIZE/page_size];
-    // Initialize the array
-    for (int i = 0; i < MEMORY_SIZE / page_size; ++i) {
-        memoryAllocation[i] = false; // false indicates no page is currently occupying this slot
-    }
-
-    this->swap_pointer = 0;
-    this->clock = 0;
-}
-
-
-char sim_mem::load(int address) {
-    // if negative address
-    if(address < 0)
-    {
-        cout << "ERR" << endl;
-        return '\0';
+        write_stats_header(stats_file, stats_output_format);
+        this->stats_next = stats_interval;
     }
-    int offset, in, out;
-    // out is external access in the page descriptor, in is internal
-    parseAddress(address, page_size, &offset, &in, &out);
+    if(concurrent && pageout_low > 0)
+        this->pageout_thread = std::thread(&sim_mem::pageOutDaemon, this);
+}
 
-    // if the page we are trying to load is valid (inside the memory), we just return the character
-    if(page_table[out][in].valid) {
-        page_table[out][in].last_access = clock++;
-        return main_memory[(page_table[out][in].frame)*page_size + offset];
+
+// a fault on a text or data page that continues a sequential stream reads ahead: the following
+// pages come in with it, in the same preadv. the window doubles while every page read ahead
+// gets used and halves when most of them aren't or one is evicted untouched. this picks the
+// window, evicts what it takes to have free frames for all of it (within the frame quota) and
+// maps the extra pages to their frames. returns how many pages after `in` were mapped, the
+// caller reads them with readExec
+int sim_mem::startReadAhead(int out, int in)
+{
+    readahead_window &ra = readahead[out];
+    if(in != ra.next) { // not sequential, no read-ahead until the stream shows
+        ra.next = in + 1;
+        ra.issued = 0;
+        ra.used = 0;
+        return 0;
+    }
+    if(ra.issued > 0 && ra.used >= ra.issued)
+        ra.size = std::min(ra.size * 2, readahead_max);
+    else if(ra.used * 2 < ra.issued)
+        ra.size = std::max(std::min(READAHEAD_MIN, readahead_max), ra.size / 2);
+    // never more than half of the frames the address space may hold
+    int window = std::min(ra.size, std::max(1, (frame_quota > 0 ? frame_quota : num_frames) / 2));
+    // the window ends before the first page that is resident, comes from the swap or is another
+    // address space's shared text
+    int extra = 0;
+    while (extra + 1 < window && in + extra + 1 < seg_pages[out]) {
+        int page = in + extra + 1;
+        if(page_table[out][page].valid || page_table[out][page].in_swap ||
+           (out == TEXT_SEGMENT && share_text && memory->text_frames.count(physical_memory::textKey(exec_id, page))))
+            break;
+        extra++;
+    }
+    ra.next = in + extra + 1;
+    ra.issued = 0;
+    ra.used = 0;
+    if(extra == 0)
+        return 0;
+
+    // room for the whole window, so no page of it can be picked as a victim while it is mapped
+    while (memory->free_frames->available() < extra + 1 ||
+           (frame_quota > 0 && owned_frames + extra + 1 > frame_quota)) {
+        direct_reclaim = true;
+        int victim = policy->select_victim();
+        memory->reclaimFrame(victim);
+        memory->free_frames->release(victim);
+    }
+    for (int i = 1; i <= extra; i++) {
+        policy->on_fault(key_base + pageKey(out, in + i));
+        int frame = memory->free_frames->allocate();
+        page_descriptor &page = page_table[out][in + i];
+        page.valid = true;
+        page.frame = frame;
+        page.prefetched = true;
+        trackFrame(frame, out, in + i);
+    }
+    return extra;
+}
+
+// reads the faulting exec page into frame, and the `extra` pages after it startReadAhead mapped
+// into theirs, with one preadv. read-ahead pages the read didn't reach (past the end of the exec)
+// are unmapped again. returns what reading the faulting page returned
+ssize_t sim_mem::readExec(int out, int in, int frame, int extra)
+{
+    off_t offset = exec_read_start_buffer(out) + (off_t)in * page_size;
+    counters.exec_read(out, (long)(extra + 1) * page_size);
+    if(extra == 0)
+        return exec_file.read(frameAddress(frame), offset, page_size);
+
+    readahead_io[0].iov_base = frameAddress(frame);
+    readahead_io[0].iov_len = page_size;
+    for (int i = 1; i <= extra; i++) {
+        readahead_io[i].iov_base = frameAddress(page_table[out][in + i].frame);
+        readahead_io[i].iov_len = page_size;
     }
-    else // page not in the memory
+    ssize_t result = exec_file.readv(readahead_io.data(), extra + 1, offset);
+    int mapped = 0;
+    for (int i = 1; i <= extra; i++) {
+        page_descriptor &page = page_table[out][in + i];
+        if(result >= (ssize_t)(i + 1) * page_size) {
+            mapped++;
+            continue;
+        }
+        policy->on_remove(page.frame);
+        if(out == TEXT_SEGMENT && share_text)
+            memory->text_frames.erase(physical_memory::textKey(exec_id, in + i));
+        frames[page.frame].owner = nullptr;
+        frames[page.frame].mappers = 0;
+        memory->free_frames->release(page.frame);
+        page.valid = false;
+        page.frame = -1;
+        page.prefetched = false;
+        owned_frames--;
+        countResident(-1);
+    }
+    counters.prefetch(out, mapped);
+    readahead[out].issued = mapped;
+    if(result == -1)
+        return -1;
+    return std::min<ssize_t>(result, page_size);
+}
+
+// first access to a page that was read ahead
+void sim_mem::prefetchUsed(int out, int in)
+{
+    page_table[out][in].prefetched = false;
+    counters.prefetch_hit(out);
+    readahead[out].used++;
+}
+
+// brings a page that isn't in memory into a frame for a load or a store and returns the frame,
+// -1 (after printing ERR) when the access isn't allowed or the page can't be read
+int sim_mem::pageIn(int out, int in, bool for_store)
+{
+    // trying to load from heap_stack that was never stored to (not in swap), err
+    if(!for_store && out == HEAP_STACK_SEGMENT && !inSwap(out, in))
     {
-        // if we have space in the memory
-        int mem_slot = isMemoryAvailable(this->memoryAllocation, MEMORY_SIZE/page_size);
-        // if we are in the text segment, we load it from exec as there's no reason to save it up in swap
-        if(out == TEXT_SEGMENT) // page is text and then its in exec
-        {
-            // if there's no space in memory
-            if(mem_slot == -1)
-            {
-                // we check use which page to evict
-                int outter = 0, inner = 0;
-                int mem_pos = evictPage(&outter, &inner);
-                // we check if it's valid and dirty we need to send it to the swap to back it up
-                if(this->page_table[outter][inner].valid && page_table[outter][inner].dirty && outter != TEXT_SEGMENT)
-                {
-                    move_to_swap(this->swapfile_fd, &this->swap_pointer, this->page_table,
-                                 outter, inner, page_size, bss_size, data_size, heap_stack_size);
-                    page_table[outter][inner].valid = false;
-                    memoryAllocation[page_table[outter][inner].frame] = false;
-                    page_table[outter][inner].frame = -1;
-
-                    mem_slot = mem_pos;
-                }
-                else // no need to send to swap, we just load up the page and use it's frame
-                {
-                    mem_slot = page_table[outter][inner].frame;
-                    page_table[outter][inner].valid = false;
-                    page_table[outter][inner].frame = -1;
-                    memoryAllocation[page_table[outter][inner].frame] = false;
-                }
-            }
-            // since we are in text segment we load it up from the exec_file
-            lseek(this->program_fd, in * page_size, SEEK_SET); //set the cursor at the beginning
-            int read_result = read(this->program_fd, &main_memory[mem_slot *page_size], page_size);
-            if(read_result == -1) {
-                cout << "ERR" << endl;
-                return '\0';
-            }
-            page_table[out][in].valid = true;
-            page_table[out][in].frame = mem_slot;
-            page_table[out][in].last_access = clock++;
-            memoryAllocation[page_table[out][in].frame] = true;
-            return main_memory[(page_table[out][in].frame)*page_size + offset];
+        cout << "ERR" << endl;
+        return -1;
+    }
+    page_descriptor &page = page_table[out][in];
+    uint64_t started = counters.clock();
+    // another address space running the same exec may have the text page in memory already,
+    // mapping its frame is a minor fault
+    if(out == TEXT_SEGMENT && share_text) {
+        auto shared = memory->text_frames.find(physical_memory::textKey(exec_id, in));
+        if(shared != memory->text_frames.end()) {
+            int frame = shared->second;
+            sim_mem* owner = frames[frame].owner;
+            if(owner->page_table.find(TEXT_SEGMENT, in)->prefetched)
+                owner->prefetchUsed(TEXT_SEGMENT, in);
+            frames[frame].mappers++;
+            page.valid = true;
+            page.frame = frame;
+            touchFrame(frame);
+            countResident(1);
+            counters.fault(out, false, started);
+            return frame;
+        }
+    }
+    // whatever evicts a page on the way sets it again, concurrent mode counts in claimFrame
+    if(!concurrent)
+        direct_reclaim = false;
+    if(large_pages && large_order[out] > 0)
+        return pageInLarge(out, in, for_store, started);
+    // text and data coming from the exec may read ahead, the extra pages get their frames first
+    int readahead_pages = 0;
+    if(readahead_max > 0 && !page.in_swap && (out == TEXT_SEGMENT || out == DATA_SEGMENT))
+        readahead_pages = startReadAhead(out, in);
+    int mem_slot;
+    if(concurrent) {
+        mem_slot = claimFrame(pageKey(out, in) & (PAGE_STRIPES - 1), out);
+    }
+    else {
+        policy->on_fault(key_base + pageKey(out, in));
+        mem_slot = promote_order > 0 ? groupFrame(out, in) : -1;
+        if(mem_slot == -1)
+            mem_slot = acquireFrame();
+    }
 
+    int read_result = page_size;
+    bool major = true; // the page came from a file
+    if(page.in_swap) {
+        // loading from swap to main memory, the page comes back clean and keeps its slot,
+        // evicting it again costs no write
+        // async swap may still have the slot in its write-back or read-ahead buffers
+        read_result = readSwap(frameAddress(mem_slot), page.swap_index, &major);
+        counters.swap_in(out, major ? page_size : 0);
+    }
+    else if(for_store && (out == HEAP_STACK_SEGMENT || out == BSS_SEGMENT)) {
+        // the first store to a heap_stack or bss page starts from a blank page (0s)
+        memset(frameAddress(mem_slot), '0', page_size);
+        major = false;
+    }
+    else {
+        // text, data and bss that was never stored to come from the exec file
+        read_result = readExec(out, in, mem_slot, readahead_pages);
+    }
+    if(read_result == -1) {
+        cout << "ERR" << endl;
+        if(concurrent) {
+            frame_owner[mem_slot].store(FRAME_FREE, std::memory_order_release);
+            frame_pool->release(mem_slot);
         }
-        else //not in text segment
-        {
-            // if dirty
-            if (this->page_table[out][in].dirty) // dirty means the page is in the swap
-            {
-                // making a buffer to update the swap with 0s
-                char buffer[this->page_size];
-                for (int i = 0; i < this->page_size; ++i) {
-                    buffer[i] = '0';
-                }
-                if(mem_slot == -1) //there's no space in the memory
-                {
-                    // grabbing the page we need to evict
-                    int outter = 0, inner = 0;
-                    int mem_pos = evictPage(&outter, &inner);
-                    // we need to back it up in the swap if it's not a text and it's dirty and valid
-                    if(this->page_table[outter][inner].valid && page_table[outter][inner].dirty && outter != TEXT_SEGMENT)
-                    {
-                        move_to_swap(this->swapfile_fd, &this->swap_pointer, this->page_table,
-                                     outter, inner, page_size, bss_size, data_size, heap_stack_size);
-                        page_table[outter][inner].valid = false;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                        page_table[outter][inner].frame = -1;
-                        mem_slot = mem_pos;
-                    }
-                    else // no need to send to swap
-                    {
-                        mem_slot = page_table[outter][inner].frame;
-                        page_table[outter][inner].valid = false;
-                        page_table[outter][inner].frame = -1;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                    }
-                }
-                // loading from swap to main memory
-                lseek(swapfile_fd, page_table[out][in].swap_index * page_size, SEEK_SET);
-                int read_result = read(this->swapfile_fd, &main_memory[mem_slot * page_size], page_size);
-                if(read_result == -1) {
-                    cout << "ERR" << endl;
-                    return '\0';
-                }
+        else {
+            memory->free_frames->release(mem_slot);
+        }
+        return -1;
+    }
 
-                // filling the swap with zeros
-                lseek(swapfile_fd, page_table[out][in].swap_index * page_size, SEEK_SET);
-                int write_result = write(this->swapfile_fd, buffer, page_size);
-                if(write_result == -1) { // error writing
-                    cout << "ERR" << endl;
-                    return '\0';
-                }
-                page_table[out][in].valid = true;
-                page_table[out][in].frame = mem_slot;
-                page_table[out][in].last_access = clock++;
-                memoryAllocation[page_table[out][in].frame] = true;
-                // double check once again the two below
-                page_table[out][in].swap_index = -1;
-                return main_memory[(page_table[out][in].frame)*page_size + offset];
-            }
-            else // not dirty = not in swap so we read from exec
-            {
-                // trying to load from heap_stack, err
-                if(out == HEAP_STACK_SEGMENT) // trying to load from heap stack
-                {
-                    cout << "ERR" << endl;
-                    return '\0';
-                }
-                // if there's no space in the main memory
-                if(mem_slot == -1)
-                {
-                    // we look for which page to evict again
-                    int outter = 0, inner = 0;
-                    int mem_pos = evictPage(&outter, &inner);
-                    // we need to back it up in the swap
-                    if(this->page_table[outter][inner].valid && page_table[outter][inner].dirty && outter != TEXT_SEGMENT)
-                    {
-                        move_to_swap(this->swapfile_fd, &this->swap_pointer, this->page_table,
-                                     outter, inner, page_size, bss_size, data_size, heap_stack_size);
-                        page_table[outter][inner].valid = false;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                        page_table[outter][inner].frame = -1;
-
-                        mem_slot = mem_pos;
-                    }
-                    else // no need to send to swap
-                    {
-                        mem_slot = page_table[outter][inner].frame;
-                        page_table[outter][inner].valid = false;
-                        page_table[outter][inner].frame = -1;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                    }
-                }
-                // grabbing it from exec file
-                int start_buff = exec_read_start_buffer(out);
-                lseek(this->program_fd, start_buff + in * page_size, SEEK_SET); //set the cursor at the beginning
-                int read_result = read(this->program_fd, &main_memory[mem_slot * page_size], page_size);
-                if(read_result == -1) {
-                    cout << "ERR" << endl;
-                    return '\0';
-                }
-                page_table[out][in].valid = true;
-                page_table[out][in].frame = mem_slot;
-                page_table[out][in].last_access = clock++;
-                memoryAllocation[page_table[out][in].frame] = true;
-                return main_memory[(page_table[out][in].frame)*page_size + offset];
+    page.valid = true;
+    page.frame = mem_slot;
+    if(for_store)
+        markDirty(out, in);
+    trackFrame(mem_slot, out, in);
+    if(direct_reclaim)
+        counters.direct_reclaim(out);
+    counters.fault(out, major, started);
+    // a promotion may copy the page to another frame
+    if(promote_order > 0)
+        promoteGroups(out, in, in + readahead_pages);
+    return page.frame;
+}
+
+// a fault in a segment of large pages brings in the whole large page holding the page, with one
+// read of the exec or of the swap when its pages sit in a run of slots
+int sim_mem::pageInLarge(int out, int in, bool for_store, uint64_t started)
+{
+    int order = large_order[out];
+    int count = 1 << order;
+    int first = in & ~(count - 1);
+    size_t bytes = (size_t)count * page_size;
+    policy->on_fault(key_base + pageKey(out, first));
+    int frame = acquireBlock(order);
 
+    ssize_t read_result = (ssize_t)bytes;
+    bool major = true;
+    // a large page's pages come and go together, all of them are in the swap or none is
+    if(page_table[out][first].in_swap) {
+        int slot = page_table[out][first].swap_index;
+        bool run = memory->zswap == nullptr && memory->swap_async == nullptr;
+        for (int i = 1; i < count && run; i++)
+            run = page_table[out][first + i].swap_index == slot + i;
+        if(run) {
+            memory->swap_reads++;
+            read_result = memory->swap_file.read(frameAddress(frame), (off_t)slot * page_size, bytes);
+            counters.swap_in(out, (long)bytes);
+            counters.large_io(out, count);
+        }
+        else {
+            major = false;
+            for (int i = 0; i < count; i++) {
+                bool from_disk;
+                if(readSwap(frameAddress(frame + i), page_table[out][first + i].swap_index, &from_disk) == -1)
+                    read_result = -1;
+                counters.swap_in(out, from_disk ? page_size : 0);
+                major = major || from_disk;
             }
         }
     }
+    else if(for_store && (out == HEAP_STACK_SEGMENT || out == BSS_SEGMENT)) {
+        memset(frameAddress(frame), '0', bytes);
+        major = false;
+    }
+    else {
+        counters.exec_read(out, (long)bytes);
+        read_result = exec_file.read(frameAddress(frame), exec_read_start_buffer(out) + (off_t)first * page_size, bytes);
+    }
+    if(read_result == -1) {
+        cout << "ERR" << endl;
+        for (int i = 0; i < count; i++)
+            memory->free_frames->release(frame + i);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        page_descriptor &page = page_table[out][first + i];
+        page.valid = true;
+        page.frame = frame + i;
+        frame_order[frame + i] = order;
+        if(i > 0) {
+            frames[frame + i].owner = this;
+            frames[frame + i].segment = out;
+            frames[frame + i].page = first + i;
+            frames[frame + i].mappers = 1;
+        }
+    }
+    owned_frames += count - 1;
+    countResident(count - 1);
+    trackFrame(frame, out, first); // the policy knows the large page by its first frame
+    if(for_store)
+        markDirty(out, in);
+    counters.large_fault(out, count);
+    if(direct_reclaim)
+        counters.direct_reclaim(out);
+    counters.fault(out, major, started);
+    return frame + in - first;
+}
+
+char sim_mem::load(uint64_t address) {
+    if(concurrent)
+        return concurrentLoad(address);
+    countAccess();
+    // hot pages are found in the TLB without looking at the page table, addresses outside the
+    // address space never match an entry
+    if(tlb_shift >= 0) {
+        tlb_entry* entry = large_pages ? lookupLarge(address) : tlb.lookup(address >> tlb_shift);
+        if(entry != nullptr) {
+            touchFrame(entry->frame);
+            counters.hit(entry->segment);
+            return *entryByte(entry, address);
+        }
+    }
+    int offset, in, out;
+    // out is external access in the page descriptor, in is internal
+    // addresses outside the address space or the segments (including negative ones) are errors
+    if(!parseAddress(address, &offset, &in, &out))
+    {
+        cout << "ERR" << endl;
+        return '\0';
+    }
+
+    // if the page we are trying to load is valid (inside the memory), we just return the character.
+    // find() doesn't allocate, a radix table only grows when a page faults in
+    page_descriptor *page = page_table.find(out, in);
+    if(page != nullptr && page->valid) {
+        if(page->prefetched)
+            prefetchUsed(out, in);
+        touchFrame(page->frame);
+        counters.hit(out);
+        cacheTranslation(out, in);
+        return frameAddress(page->frame)[offset];
+    }
+    // page not in the memory
+    int frame = pageIn(out, in, false);
+    if(frame == -1)
+        return '\0';
+    cacheTranslation(out, in);
+    return frameAddress(frame)[offset];
 }
 
-void sim_mem::store(int address, char value) {
+void sim_mem::store(uint64_t address, char value) {
+    if(concurrent) {
+        concurrentStore(address, value);
+        return;
+    }
+    countAccess();
+    // only pages that are already dirty are stored to through the TLB, a clean one takes the
+    // slow path once to be marked dirty (and text never gets there)
+    if(tlb_shift >= 0) {
+        tlb_entry* entry = large_pages ? lookupLarge(address) : tlb.lookup(address >> tlb_shift);
+        if(entry != nullptr && entry->dirty) {
+            touchFrame(entry->frame);
+            counters.hit(entry->segment);
+            *entryByte(entry, address) = value;
+            return;
+        }
+    }
     int offset, in, out;
     // out is external access in the page descriptor, in is internal
-    parseAddress(address, page_size, &offset, &in, &out);
+    if(!parseAddress(address, &offset, &in, &out))
+    {
+        cout << "ERR" << endl;
+        return;
+    }
 
-    // if the page we are trying to load is valid, we just return the character
     //if we are trying to store in text segment, we throw an error
     if(out == TEXT_SEGMENT)
     {
@@ -385,196 +1324,293 @@ void sim_mem::store(int address, char value) {
         return;
     }
     // if page is valid, we just update it
-    if(page_table[out][in].valid) {
-        page_table[out][in].last_access = clock++;
-        main_memory[(page_table[out][in].frame)*page_size + offset] = value;
-        page_table[out][in].dirty = true;
+    page_descriptor *page = page_table.find(out, in);
+    if(page != nullptr && page->valid) {
+        if(page->prefetched)
+            prefetchUsed(out, in);
+        touchFrame(page->frame);
+        counters.hit(out);
+        frameAddress(page->frame)[offset] = value;
+        if(!page->dirty)
+            markDirty(out, in);
+        cacheTranslation(out, in);
+        return;
     }
-    else
+    int frame = pageIn(out, in, true);
+    if(frame == -1)
+        return;
+    cacheTranslation(out, in);
+    frameAddress(frame)[offset] = value;
+}
+
+// load for concurrent mode, the page's stripe is held from the lookup to the read so the page
+// can't be evicted in between
+char sim_mem::concurrentLoad(uint64_t address) {
+    int offset, in, out;
+    if(!parseAddress(address, &offset, &in, &out))
     {
-        // if we are not in text segment
-        if((out != TEXT_SEGMENT)) // the other segments
-        {
-            // checking if there's a spot in the ram
-            int mem_slot = isMemoryAvailable(this->memoryAllocation,MEMORY_SIZE/page_size);
-            if(!page_table[out][in].dirty) // if page is not dirty,
-            {
-                // if there's no space in the main memory
-                if(mem_slot == -1) {
-                    int outter = 0, inner = 0;
-                    int mem_pos = evictPage(&outter, &inner);
-                    // we don't need to send text to swap, we just take it from the exec
-                    if (this->page_table[outter][inner].valid && page_table[outter][inner].dirty &&
-                        outter != TEXT_SEGMENT) {
-                        move_to_swap(this->swapfile_fd, &this->swap_pointer, this->page_table,
-                                     outter, inner, page_size, bss_size, data_size, heap_stack_size);
-                        page_table[outter][inner].valid = false;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                        page_table[outter][inner].frame = -1;
-                        mem_slot = mem_pos;
-                    } else // no need to send to swap
-                    {
-                        mem_slot = page_table[outter][inner].frame;
-                        page_table[outter][inner].valid = false;
-                        page_table[outter][inner].frame = -1;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                    }
-                }
-                // if we are in the heap stack segment, we first load a blank page (0s)
-                if(out == HEAP_STACK_SEGMENT || out == BSS_SEGMENT) // if we are in heap_stack segment
-                {
-                    // we initiate a new page of zero
-                    for (int i = 0; i < page_size; ++i) {
-                        main_memory[mem_slot*page_size + i] = '0';
-                    }
-                }
-                else
-                {
-                    // if we are in data, we load it up from exec_file
-                    int start_buff = exec_read_start_buffer(out);
-                    lseek(this->program_fd, start_buff + in * page_size, SEEK_SET); //set the cursor at the beginning
-                    int read_result = read(this->program_fd, &main_memory[mem_slot * page_size], page_size);
-                    if(read_result == -1) {
-                        cout << "ERR" << endl;
-                        return;
-                    }
-                }
-                page_table[out][in].valid = true;
-                page_table[out][in].frame = mem_slot;
-                page_table[out][in].dirty = true;
-                page_table[out][in].last_access = clock++;
-                memoryAllocation[page_table[out][in].frame] = true;
-                main_memory[mem_slot*page_size + offset] = value;
+        cout << "ERR" << endl;
+        return '\0';
+    }
+    page_stripe &stripe = stripeOf(out, in);
+    std::lock_guard<std::mutex> held(stripe.lock);
+    if(SIM_MEM_STATS)
+        stripe.accesses++;
+    page_descriptor &page = page_table[out][in];
+    if(page.valid) {
+        referenceFrame(page.frame);
+        if(SIM_MEM_STATS)
+            stripe.hits[out]++;
+        return frameAddress(page.frame)[offset];
+    }
+    int frame = pageIn(out, in, false);
+    if(frame == -1)
+        return '\0';
+    return frameAddress(frame)[offset];
+}
 
-            }
-            else // if page is dirty
-            {
-                char buffer[this->page_size];
-                for (int i = 0; i < this->page_size; ++i) {
-                    buffer[i] = '0';
-                }
+void sim_mem::concurrentStore(uint64_t address, char value) {
+    int offset, in, out;
+    if(!parseAddress(address, &offset, &in, &out) || out == TEXT_SEGMENT)
+    {
+        cout << "ERR" << endl;
+        return;
+    }
+    page_stripe &stripe = stripeOf(out, in);
+    std::lock_guard<std::mutex> held(stripe.lock);
+    if(SIM_MEM_STATS)
+        stripe.accesses++;
+    page_descriptor &page = page_table[out][in];
+    if(page.valid) {
+        referenceFrame(page.frame);
+        if(SIM_MEM_STATS)
+            stripe.hits[out]++;
+        frameAddress(page.frame)[offset] = value;
+        if(!page.dirty)
+            markDirty(out, in);
+        return;
+    }
+    int frame = pageIn(out, in, true);
+    if(frame == -1)
+        return;
+    frameAddress(frame)[offset] = value;
+}
 
-                if(mem_slot == -1) //there's no space in main memory
-                {
-                    // if there's no space in the main memory
-                    int outter = 0, inner = 0;
-                    int mem_pos = evictPage(&outter, &inner);
-                    // if we need to back it up in the swap
-                    if(this->page_table[outter][inner].valid && page_table[outter][inner].dirty && outter != TEXT_SEGMENT)
-                    {
-                        move_to_swap(this->swapfile_fd, &this->swap_pointer, this->page_table,
-                                     outter, inner, page_size, bss_size, data_size, heap_stack_size);
-                        page_table[outter][inner].valid = false;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                        page_table[outter][inner].frame = -1;
-
-                        mem_slot = mem_pos;
-                    }
-                    else // no need to send to swap
-                    {
-                        mem_slot = page_table[outter][inner].frame;
-                        page_table[outter][inner].valid = false;
-                        page_table[outter][inner].frame = -1;
-                        memoryAllocation[page_table[outter][inner].frame] = false;
-                    }
+// copies len bytes between a buffer and the virtual range starting at address. the range is
+// translated once per page, pages that aren't resident are faulted in back to back before any
+// copying (when they fit in half of memory) and each page's part is a single memcpy. returns
+// the bytes transferred, less than len when an ERR stopped it
+long sim_mem::transferRange(uint64_t address, char* buffer, long len, bool for_store)
+{
+    if(len <= 0)
+        return 0;
+    if(!concurrent)
+        countAccess();
+    int offset, in, out;
+    long spans = ((long)(address % page_size) + len + page_size - 1) / page_size;
 
+    // the pages the batch faulted in, their access is counted already and the copy loop doesn't
+    // count a hit for them too. failed is the page whose fault printed ERR, -1 if none did
+    std::vector<bool> faulted;
+    long failed = -1;
+    // with other threads faulting too the batch wouldn't stay resident, concurrent mode skips it
+    if(!concurrent && spans <= num_frames / 2) {
+        faulted.resize(spans);
+        uint64_t position = address;
+        for (long span = 0, done = 0; done < len; span++) {
+            if(!parseAddress(position, &offset, &in, &out) || (for_store && out == TEXT_SEGMENT) ||
+               (!for_store && out == HEAP_STACK_SEGMENT && !inSwap(out, in)))
+                break; // the copy loop stops there and reports it
+            long n = std::min<long>(page_size - offset, len - done);
+            const page_descriptor *page = page_table.find(out, in);
+            if(page == nullptr || !page->valid) {
+                if(pageIn(out, in, for_store) == -1) {
+                    failed = span; // the copy loop copies the pages before it
+                    break;
                 }
+                faulted[span] = true;
+            }
+            done += n;
+            position += n;
+        }
+    }
 
-                // loading from swap to main memory
-                lseek(swapfile_fd, page_table[out][in].swap_index * page_size, SEEK_SET);
-                int read_result = read(this->swapfile_fd, &main_memory[mem_slot * page_size], page_size);
-                if(read_result == -1) {
-                    cout << "ERR" << endl;
-                    return;
-                }
-                // writing zeros into the swap
-                lseek(swapfile_fd, page_table[out][in].swap_index * page_size, SEEK_SET);
-                int write_result = write(this->swapfile_fd, buffer, page_size);
-                if(write_result == -1) { // error writing
-                    cout << "ERR" << endl;
-                    return;
-                }
-                page_table[out][in].valid = true;
-                page_table[out][in].dirty = true;
-                page_table[out][in].frame = mem_slot;
-                page_table[out][in].last_access = clock++;
-                memoryAllocation[page_table[out][in].frame] = true;
-                // double check once again the two below
-                page_table[out][in].swap_index = -1;
-                main_memory[(page_table[out][in].frame)*page_size + offset] = value;
+    long done = 0;
+    for (long span = 0; done < len; span++) {
+        if(span == failed)
+            return done;
+        if(!parseAddress(address + done, &offset, &in, &out) || (for_store && out == TEXT_SEGMENT))
+        {
+            cout << "ERR" << endl;
+            return done;
+        }
+        long n = std::min<long>(page_size - offset, len - done);
+        // concurrent mode holds each page's stripe while its part is copied
+        std::unique_lock<std::mutex> held;
+        if(concurrent) {
+            page_stripe &stripe = stripeOf(out, in);
+            held = std::unique_lock<std::mutex>(stripe.lock);
+            if(SIM_MEM_STATS && done == 0)
+                stripe.accesses++;
+        }
+        int frame;
+        page_descriptor *page = page_table.find(out, in);
+        if(page != nullptr && page->valid) {
+            frame = page->frame;
+            if(concurrent) {
+                referenceFrame(frame);
+                if(SIM_MEM_STATS)
+                    stripeOf(out, in).hits[out]++;
             }
+            else if(span >= (long)faulted.size() || !faulted[span]) {
+                if(page->prefetched)
+                    prefetchUsed(out, in);
+                touchFrame(frame);
+                counters.hit(out);
+            }
+            if(for_store && !page->dirty)
+                markDirty(out, in);
+        }
+        else { // evicted again since the batch, or the range was too big for one
+            frame = pageIn(out, in, for_store);
+            if(frame == -1)
+                return done;
         }
+        if(for_store)
+            memcpy(frameAddress(frame) + offset, buffer + done, n);
+        else
+            memcpy(buffer + done, frameAddress(frame) + offset, n);
+        done += n;
     }
+    return done;
 }
 
-void sim_mem::print_memory() {
-    printf("\n Physical memory:\n");
-    for (int i = 0; i < MEMORY_SIZE; i++) {
-        printf("[%c]\n", main_memory[i]);
+long sim_mem::load_range(uint64_t address, char* dst, long len) {
+    return transferRange(address, dst, len, false);
+}
+
+long sim_mem::store_range(uint64_t address, const char* src, long len) {
+    return transferRange(address, (char*)src, len, true);
+}
+
+// copies len bytes between two virtual ranges, overlapping ranges behave like memmove.
+// it goes through a bounce buffer so both ends never have to be resident at the same time
+long sim_mem::copy(uint64_t dst_address, uint64_t src_address, long len) {
+    if(len <= 0)
+        return 0;
+    long chunk = std::min<long>(len, 64 * 1024);
+    std::vector<char> bounce(chunk);
+    bool backward = dst_address > src_address && dst_address < src_address + len;
+    long done = 0;
+    while (done < len) {
+        long n = std::min(chunk, len - done);
+        long position = backward ? len - done - n : done;
+        if(load_range(src_address + position, bounce.data(), n) != n)
+            return done;
+        if(store_range(dst_address + position, bounce.data(), n) != n)
+            return done;
+        done += n;
     }
+    return done;
+}
+
+void sim_mem::print_memory() {
+    memory->print_memory();
 }
 
 void sim_mem::print_swap() {
-    char* str = (char*)malloc(this->page_size * sizeof(char));
-    printf("\n Swap memory\n");
-    lseek(swapfile_fd, 0, SEEK_SET); // go to the start of the file
-    while(read(swapfile_fd, str, this->page_size) == this->page_size) {
-        for (int i = 0; i < page_size; i++) {
-            printf("%d - [%c]\t", i, str[i]);
+    memory->print_swap();
+}
+
+// pages a radix table never allocated are printed as the unmapped page they are
+void sim_mem::print_page_table() {
+    const page_descriptor unmapped = {false, false, false, false, -1, -1};
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        printf("Valid\t Dirty\t Frame\t Swap index\n");
+        for (int i = 0; i < seg_pages[seg]; i++) {
+            const page_descriptor* page = page_table.find(seg, i);
+            if(page == nullptr)
+                page = &unmapped;
+            printf("[%d]\t[%d]\t[%d]\t[%d]\n",
+                   page->valid,
+                   page->dirty,
+                   page->frame ,
+                   page->swap_index);
         }
-        printf("\n");
     }
 }
 
-void sim_mem::print_page_table() {
-    int i;
-    int num_of_txt_pages = text_size / page_size;
-    int num_of_data_pages = data_size / page_size;
-    int num_of_bss_pages = bss_size / page_size;
-    int num_of_stack_heap_pages = heap_stack_size / page_size;
-    printf("Valid\t Dirty\t Frame\t Swap index\n");
-    for(i = 0; i < num_of_txt_pages; i++) {
-        printf("[%d]\t[%d]\t[%d]\t[%d]\n",
-               page_table[0][i].valid,
-               page_table[0][i].dirty,
-               page_table[0][i].frame ,
-               page_table[0][i].swap_index);
-    }
-    printf("Valid\t Dirty\t Frame\t Swap index\n");
-    for(i = 0; i < num_of_data_pages; i++) {
-        printf("[%d]\t[%d]\t[%d]\t[%d]\n",
-               page_table[1][i].valid,
-               page_table[1][i].dirty,
-               page_table[1][i].frame ,
-               page_table[1][i].swap_index);
-    }
-    printf("Valid\t Dirty\t Frame\t Swap index\n");
-    for(i = 0; i < num_of_bss_pages; i++) {
-        printf("[%d]\t[%d]\t[%d]\t[%d]\n",
-               page_table[2][i].valid,
-               page_table[2][i].dirty,
-               page_table[2][i].frame ,
-               page_table[2][i].swap_index);
-    }
-    printf("Valid\t Dirty\t Frame\t Swap index\n");
-    for(i = 0; i < num_of_stack_heap_pages; i++) {
-        printf("[%d]\t[%d]\t[%d]\t[%d]\n",
-               page_table[3][i].valid,
-               page_table[3][i].dirty,
-               page_table[3][i].frame ,
-               page_table[3][i].swap_index);
+// evicts pages until the address space is back within its frame quota, which a shared text frame
+// it inherited can take it over
+void sim_mem::shrinkToQuota() {
+    while (frame_quota > 0 && owned_frames > frame_quota) {
+        int frame = policy->select_victim();
+        memory->reclaimFrame(frame);
+        memory->free_frames->release(frame);
     }
 }
 
+// an address space leaving a shared memory gives back its frames and swap slots. a text frame
+// other address spaces still map stays, charged to one of them
+void sim_mem::releasePages() {
+    page_table.for_each([&](int seg, int i, page_descriptor &page) {
+        if(page.in_swap)
+            memory->releaseSlot(page.swap_index);
+        if(!page.valid)
+            return;
+        frame_descriptor &frame = frames[page.frame];
+        if(frame.mappers > 1) {
+            frame.mappers--;
+            if(frame.owner == this) {
+                sim_mem* heir = memory->otherMapper(page.frame, this);
+                frame.owner = heir;
+                heir->owned_frames++;
+                if(memory->scope == LOCAL_REPLACEMENT) {
+                    heir->policy->on_insert(page.frame, heir->pageKey(seg, i));
+                    heir->shrinkToQuota();
+                }
+            }
+            return;
+        }
+        if(seg == TEXT_SEGMENT && share_text)
+            memory->text_frames.erase(physical_memory::textKey(exec_id, i));
+        if(memory->scope == GLOBAL_REPLACEMENT)
+            memory->policy->on_remove(page.frame);
+        frame.owner = nullptr;
+        frame.mappers = 0;
+        memory->free_frames->release(page.frame);
+    });
+}
+
 sim_mem::~sim_mem() {
-    for (int i = 0; i < NUM_OF_SEGMENTS; i++) {
-        delete [] page_table[i];
+    if(pageout_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> held(pageout_lock);
+            pageout_stop = true;
+        }
+        pageout_wake.notify_one();
+        pageout_thread.join();
+    }
+    // under local replacement the policy is the address space's own
+    if(policy != memory->policy)
+        delete policy;
+    if(owns_memory) {
+        delete memory; // drains the write-back buffer into the swap file
+    }
+    else {
+        releasePages();
+        memory->detach(this, swap_pages, frame_quota);
+    }
+    delete[] stripes;
+    delete frame_pool;
+    delete[] frame_owner;
+    delete[] frame_referenced;
+    delete[] clock_shards;
+    if(stats_file != nullptr) {
+        write_stats(stats_file, counters.snapshot(), stats_output_format); // the final count
+        if(stats_file != stdout)
+            fclose(stats_file);
     }
 
-    delete [] page_table;
-    delete[] memoryAllocation;
-
-    close(this->swapfile_fd);
-    close(this->program_fd);
 }
 
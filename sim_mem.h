@@ -10,10 +10,26 @@
 #include <unistd.h>
 #include <string>
 #include <climits>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
 
+#include "async_swap.h"
+#include "backing_file.h"
+#include "bitmap_allocator.h"
+#include "page_table.h"
+#include "physical_memory.h"
+#include "replacement_policy.h"
+#include "sim_stats.h"
+#include "soft_tlb.h"
+
+// defaults, both can be changed per simulator through sim_config
 #define ADDRESS_SIZE 12
 #define MEMORY_SIZE 16
-extern char main_memory[MEMORY_SIZE];
 
 #define NUM_OF_SEGMENTS 4
 
@@ -22,19 +38,133 @@ extern char main_memory[MEMORY_SIZE];
 #define BSS_SEGMENT 2
 #define HEAP_STACK_SEGMENT 3
 
+static_assert(STATS_SEGMENTS == NUM_OF_SEGMENTS, "sim_stats keeps one entry per segment");
+static_assert(TABLE_SEGMENTS == NUM_OF_SEGMENTS, "the page table has one root entry per segment");
+
 using namespace std;
 
-typedef struct page_descriptor {
-    bool valid;
-    int frame;
-    bool dirty;
-    int swap_index;
-    int last_access; // LRU
-} page_descriptor;
+// the simulated machine, every field has the value sim_mem used to be hardwired to
+typedef struct sim_config {
+    policy_type policy = LRU_POLICY;
+    long long memory_size = MEMORY_SIZE; // bytes of physical memory, owned by the simulator
+    int address_size = ADDRESS_SIZE;     // virtual address width in bits, up to 64
+    int segment_bits = 2;                // top address bits selecting the segment
+    bool huge_pages = false;             // try to back physical memory with huge pages
+    io_mode io = SYSCALL_IO;             // how pages move to and from the exec and swap files
+    bool madvise_hints = true;           // with MMAP_IO, tell the kernel how the files are used
+    async_mode async_io = ASYNC_OFF;     // write-back buffered, asynchronous swap I/O
+    int writeback_batch = 32;            // evicted pages buffered before a batch is written
+    int swap_prefetch = 4;               // slots read ahead after a swap-in from disk
+    bool swap_clustering = false;        // keep the swap slots of a segment's pages together
+    int tlb_entries = 64;                // software TLB size, 0 turns it off
+    int tlb_ways = 1;                    // TLB associativity, 1 is direct-mapped
+    long stats_interval = 0;             // write a stats snapshot every this many accesses, 0 never
+    const char* stats_output = nullptr;  // where the snapshots go, "-" is stdout
+    stats_format stats_output_format = STATS_JSON;
+    bool concurrent = false;             // load/store may be called from many threads at once
+    replacement_scope scope = GLOBAL_REPLACEMENT; // with a shared physical_memory, whose pages a fault evicts
+    int frame_quota = 0;                 // LOCAL_REPLACEMENT frames of an address space, 0 takes all unreserved
+    bool share_text = true;              // address spaces running the same exec share its text frames
+    int readahead_max = 0;               // largest exec read-ahead window in pages for text and data, 0 off
+    long long zswap_budget = 0;          // bytes of the compressed swap pool in front of the swap file, 0 off
+    int page_table_levels = 2;           // 2 is a flat array per segment, 3 or 4 a radix tree filled on demand
+    // bytes of a segment's pages, a power of two multiple of the page size the simulator is built
+    // with (its base page) that divides the segment. 0 is the base page
+    int segment_page_size[NUM_OF_SEGMENTS] = {0, 0, 0, 0};
+    int promote_order = 0;               // base page segments turn aligned groups of 2^promote_order resident pages into a large page, 0 off
+    // the page-out daemon: below pageout_low free frames it evicts pages until there are
+    // pageout_high (0 is twice pageout_low), and it writes back up to pageout_clean dirty pages
+    // the policy will evict next. single threaded it runs every pageout_interval accesses,
+    // concurrent mode gives it a thread of its own
+    int pageout_low = 0;                 // 0 turns the daemon off
+    int pageout_high = 0;
+    int pageout_clean = 8;
+    long pageout_interval = 64;
+} sim_config;
+
+// read-ahead starts with windows of this many pages
+#define READAHEAD_MIN 4
+
+// adaptive read-ahead of one segment's exec pages, in the spirit of the kernel's: a fault on the
+// page right after the last window continues a sequential stream and gets a window of its own
+typedef struct readahead_window {
+    int next;   // the page a sequential stream faults on next, just past the last window
+    int size;   // pages the next sequential fault reads, the faulting one included
+    int issued; // pages read ahead by the last window
+    int used;   // read-ahead pages accessed since then
+} readahead_window;
+
+// memory held by one address space
+typedef struct rss_usage {
+    int resident;       // pages mapped to a frame
+    int shared;         // of those, text pages other address spaces map too
+    int peak_resident;
+    int owned_frames;   // frames charged to this address space, shared ones count for one mapper
+    int frame_quota;    // LOCAL_REPLACEMENT limit on owned_frames, 0 under global replacement
+} rss_usage;
+
+// size and effectiveness of the software TLB
+typedef struct tlb_usage {
+    int entries;  // 0 when the TLB is off
+    int ways;
+    long hits;
+    long misses;  // lookups that went through the page table
+} tlb_usage;
+
+// splits a virtual address into segment (out), page inside the segment (in) and offset using
+// shifts and masks computed once from the page size, so translation allocates nothing and
+// does no floating point math
+struct address_translator {
+    int page_size;
+    uint64_t address_mask; // addresses are address_size bits wide
+    int segment_shift;     // the segment selector sits above this bit
+    uint64_t in_mask;      // the byte position inside the segment
+    int page_shift;        // log2(page_size), -1 when page_size isn't a power of two
+    int offset_mask;
+
+    void init(int page_size, int address_size, int segment_bits);
+
+    void translate(uint64_t address, int* offset, uint64_t* in, int* out) const {
+        *out = (int)(address >> segment_shift);
+        uint64_t position = address & in_mask;
+        if(page_shift >= 0) {
+            *in = position >> page_shift;
+            *offset = (int)(position & offset_mask);
+        }
+        else { // odd page sizes still work, just with a division
+            *in = position / page_size;
+            *offset = (int)(position % page_size);
+        }
+    }
+};
+
+// concurrent mode: the pages are guarded by PAGE_STRIPES locks picked by page key. each lock
+// sits on its own cache line next to the hit counters of its pages, so hits on different
+// stripes never write a shared line
+#define PAGE_STRIPES 256
+
+struct alignas(64) page_stripe {
+    std::mutex lock;
+    long accesses = 0;
+    long hits[NUM_OF_SEGMENTS] = {};
+};
+
+// concurrent mode replaces the replacement policy with a sharded CLOCK, a hand per shard of
+// frames so faulting threads don't all sweep (and bounce) the same one
+struct alignas(64) clock_shard {
+    std::atomic<unsigned> hand{0};
+    int first;  // the shard is frames [first, first + count)
+    int count;
+};
+
+// frame_owner values that aren't page keys
+#define FRAME_FREE (-1)
+#define FRAME_BUSY (-2) // being evicted or filled
 
 class sim_mem {
-    int swapfile_fd;
-    int program_fd;
+    friend class physical_memory;
+
+    backing_file exec_file;
     int text_size;
     int data_size;
     int bss_size;
@@ -42,22 +172,218 @@ class sim_mem {
     int heap_stack_size;
     int page_size;
 
-    int clock;
-    bool *memoryAllocation;
-    int swap_pointer;
+    physical_memory *memory; // frames and swap, private unless the address space was attached to one
+    bool owns_memory;
+    char *main_memory;       // memory's, cached for the hot paths
+    int num_frames;
+    frame_descriptor *frames;
+    int key_base;            // first replacement policy key of this address space
+    int swap_base;           // home slot of the first data page, for swap_clustering
+    int exec_id;             // index of the exec file in memory, for text sharing
+    bool share_text;
+    bool foreign_frames;     // hits may land on text frames tracked by another address space's policy
+    int frame_quota;
+    int owned_frames;
+    int resident_pages;
+    int peak_resident;
+    int swap_pages;          // swap slots reserved in memory
+
+    stats_collector<SIM_MEM_STATS> counters;
+    FILE* stats_file;  // periodic snapshots, nullptr when they're off
+    long stats_interval;
+    long stats_next;   // access count of the next snapshot, LONG_MAX when they're off
+    stats_format stats_output_format;
+
+    readahead_window readahead[NUM_OF_SEGMENTS];
+    int readahead_max;               // 0 when read-ahead is off
+    std::vector<struct iovec> readahead_io;
+
+    address_translator translator;
+    soft_tlb tlb;
+    int tlb_shift;     // address >> tlb_shift is the virtual page number, -1 when the TLB is off
+
+    radix_page_table page_table;
+
+    // large pages: an aligned group of 2^order base pages in 2^order aligned frames, faulted in,
+    // evicted and swapped as one and tracked by the policy through its first frame
+    bool large_pages;                      // a segment has them or promotion is on
+    int large_order[NUM_OF_SEGMENTS];      // order of a segment's pages, 0 for base pages
+    int promote_order;
+    int tlb_order[NUM_OF_SEGMENTS];        // order of the TLB entries a segment's lookups look for
+    std::vector<unsigned char> frame_order; // order of the large page holding each frame, 0 for base pages
+
+    int page_base[NUM_OF_SEGMENTS]; // key of the first page of each segment
+    int seg_pages[NUM_OF_SEGMENTS]; // number of pages in each segment
+
+    policy_type policy_kind;
+    replacement_policy *policy; // memory's under global replacement, owned under local
+
+    bool concurrent;
+    page_stripe *stripes;                          // the rest are nullptr unless concurrent
+    atomic_bitmap_allocator *frame_pool;           // replaces free_frames
+    std::atomic<int> *frame_owner;                 // page key in each frame, FRAME_FREE or FRAME_BUSY
+    std::atomic<unsigned char> *frame_referenced;  // CLOCK reference bits
+    clock_shard *clock_shards;
+    int num_shards;
+    std::mutex swap_lock;   // swap slots and async swap, when concurrent
+    std::mutex stats_lock;  // the fault path counters, when concurrent
+
+    // the page-out daemon, pageout_low is 0 when it's off
+    int pageout_low;
+    int pageout_high;
+    int pageout_clean;
+    long pageout_interval;
+    long pageout_countdown;          // accesses until its next run, single threaded
+    bool direct_reclaim;             // the fault being handled evicted a page, single threaded
+    std::vector<int> pageout_victims;
+    std::thread pageout_thread;      // concurrent mode runs it here
+    std::mutex pageout_lock;
+    std::condition_variable pageout_wake;
+    std::atomic<bool> pageout_wanted{false}; // a fault saw the free frames under pageout_low
+    bool pageout_stop;
+    unsigned pageout_shard;          // where the daemon thread's next CLOCK sweep starts
+
+    // parses the address we receive into segment, page, offset.
+    // false if the address is wider than the address size or points outside the segments
+    bool parseAddress(uint64_t address, int* offset, int* in, int* out) const {
+        if(address > translator.address_mask)
+            return false;
+        uint64_t page;
+        translator.translate(address, offset, &page, out);
+        if(*out >= NUM_OF_SEGMENTS || page >= (uint64_t)seg_pages[*out])
+            return false;
+        *in = (int)page;
+        return true;
+    }
+    // reads of the page table that must not allocate a radix leaf for a page never touched
+    bool inSwap(int out, int in) const {
+        const page_descriptor* page = page_table.find(out, in);
+        return page != nullptr && page->in_swap;
+    }
+    bool mapsFrame(int page, int frame) const {
+        const page_descriptor* text = page_table.find(TEXT_SEGMENT, page);
+        return text != nullptr && text->valid && text->frame == frame;
+    }
+    char* frameAddress(int frame) const { return main_memory + (size_t)frame * page_size; }
+    int allocateSwapSlot(int out, int in);
+    void copyToSwap(int out, int in);
+    void move_to_swap(int out, int in);
+    void markDirty(int out, int in);
+    int pageIn(int out, int in, bool for_store);
+    long transferRange(uint64_t address, char* buffer, long len, bool for_store);
+    ssize_t readSwap(char* dst, int slot, bool* from_disk);
+    ssize_t writeSwap(const char* src, int slot);
+    ssize_t writeSwapFile(const char* src, int slot);
+    int pageKey(int segment, int page) { return page_base[segment] + page; }
+    uint64_t pageNumber(int segment, int page) const {
+        return ((uint64_t)segment << (translator.segment_shift - tlb_shift)) | (uint64_t)page;
+    }
+    void cacheTranslation(int out, int in);
+    int firstFrame(int frame) const { return frame & ~((1 << frame_order[frame]) - 1); }
+    // the entry of a TLB that may hold large pages, their segments are looked up by their size
+    tlb_entry* lookupLarge(uint64_t address) {
+        int out = address <= translator.address_mask ? (int)(address >> translator.segment_shift) : NUM_OF_SEGMENTS;
+        return tlb.lookup(address >> tlb_shift, out < NUM_OF_SEGMENTS ? tlb_order[out] : 0);
+    }
+    // the byte of the page or large page an entry maps
+    char* entryByte(const tlb_entry* entry, uint64_t address) const {
+        return entry->base + (address & (((uint64_t)page_size << entry->order) - 1));
+    }
+    int pageInLarge(int out, int in, bool for_store, uint64_t started);
+    int acquireBlock(int order);
+    int groupFrame(int out, int in);
+    void promoteGroups(int out, int from, int to);
+    void demote(int out, int first);
+    void evictLarge(int out, int first);
+    int allocateSwapRun(int count);
+    void emitStats();
+    void countAccess() {
+        if(counters.access() >= stats_next)
+            emitStats();
+        if(--pageout_countdown == 0)
+            pageOut();
+    }
+    int freeFrames() const;
+    void pageOut();
+    void writeBackVictims();
+    void pageOutDaemon();
+    void concurrentPageOut();
+    void wakePageOut() {
+        if(pageout_low > 0 && frame_pool->available() < pageout_low && !pageout_wanted.exchange(true)) {
+            std::lock_guard<std::mutex> held(pageout_lock);
+            pageout_wake.notify_one();
+        }
+    }
+    void trackFrame(int frame, int segment, int page);
+    void countResident(int delta);
+    void evictResident(int out, int in);
+    void unmapShared(int frame, int page);
+    void releasePages();
+    void shrinkToQuota();
+    int startReadAhead(int out, int in);
+    ssize_t readExec(int out, int in, int frame, int extra);
+    void prefetchUsed(int out, int in);
+    void setUp(physical_memory* shared, const char* exe_file_name, const char* swap_file_name, int text_size,
+               int data_size, int bss_size, int heap_stack_size, int page_size, const sim_config& config);
+
+    std::unique_lock<std::mutex> holdSwap() {
+        return concurrent ? std::unique_lock<std::mutex>(swap_lock) : std::unique_lock<std::mutex>();
+    }
+    page_stripe& stripeOf(int out, int in) { return stripes[pageKey(out, in) & (PAGE_STRIPES - 1)]; }
+    void keyToPage(int key, int* out, int* in) const;
+    void referenceFrame(int frame) {
+        if(!frame_referenced[frame].load(std::memory_order_relaxed))
+            frame_referenced[frame].store(1, std::memory_order_relaxed);
+    }
+    int claimFrame(int own_stripe, int segment);
+    int sweepClock(int own_stripe);
+    char concurrentLoad(uint64_t address);
+    void concurrentStore(uint64_t address, char value);
 
-    page_descriptor **page_table; // pointer to page table
+    // tells the replacement policy about a hit, LRU and CLOCK are called without a virtual call
+    void touchFrame(int frame) {
+        if(large_pages)
+            frame = firstFrame(frame);
+        // a shared text frame is tracked by the policy of the address space that loaded it
+        replacement_policy *tracker = foreign_frames ? frames[frame].owner->policy : policy;
+        switch (policy_kind) {
+            case LRU_POLICY: policy_hit<lru_policy>(tracker, frame); break;
+            case CLOCK_POLICY: policy_hit<clock_policy>(tracker, frame); break;
+            default: tracker->on_hit(frame);
+        }
+    }
 
 public:
-    sim_mem(const char*, const char*, int, int, int, int, int);
-    char load(int address);
-    void store(int address, char value);
+    sim_mem(const char*, const char*, int, int, int, int, int, policy_type policy = LRU_POLICY);
+    sim_mem(const char*, const char*, int, int, int, int, int, const sim_config& config);
+    // an address space in a shared physical memory, the page size is the memory's
+    sim_mem(physical_memory& memory, const char*, int, int, int, int, const sim_config& config = sim_config());
+    char load(uint64_t address);
+    void store(uint64_t address, char value);
+    long load_range(uint64_t address, char* dst, long len);
+    long store_range(uint64_t address, const char* src, long len);
+    long copy(uint64_t dst_address, uint64_t src_address, long len);
 
     void print_memory();
     void print_swap();
     void print_page_table();
+    swap_usage swap_slot_usage();
+    zswap_usage zswap_stats();
+    tlb_usage tlb_stats();
+    rss_usage rss();
+    // bytes held by the page table, which with 3 or 4 levels grows with the pages touched
+    size_t page_table_bytes() const { return page_table.bytes(); }
+    // counters since construction, all zero in builds with SIM_MEM_STATS=0
+    sim_stats stats();
+    void print_stats(FILE* out, stats_format format = STATS_JSON);
+    // the simulator's state to path (and its swap file to path.swap) and back, for a simulator
+    // with a private memory that isn't concurrent and has no large pages. restoring needs one
+    // built the same way, the counters aren't part of a checkpoint. false and ERR on failure
+    bool save_checkpoint(const char* path);
+    bool restore_checkpoint(const char* path);
     int numOfPages(int);
     int evictPage(int*, int*);
+    int acquireFrame();
     int exec_read_start_buffer(int segment);
     ~sim_mem();
 };
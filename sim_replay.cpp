@@ -0,0 +1,270 @@
+// replays an access trace against sim_mem and reports throughput, faults and swap I/O,
+// or converts a trace between the binary and the text format (see trace.h).
+//
+//   sim_replay [options] <trace>
+//   sim_replay --convert <output> [--to binary|text] <trace>
+#include "sim_mem.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options] <trace>\n"
+            "       %s --convert <output> [--to binary|text] <trace>\n"
+            "options:\n"
+            "  --exec FILE          exec file (default exec_file)\n"
+            "  --swap FILE          swap file (default swap_file)\n"
+            "  --text/--data/--bss/--heap BYTES   segment sizes (default 1024 each)\n"
+            "  --page BYTES         page size (default 16)\n"
+            "  --text-page/--data-page/--bss-page/--heap-page BYTES   a segment's large page size,\n"
+            "                       a power of two multiple of --page\n"
+            "  --promote K          promote groups of 2^K resident pages to large pages\n"
+            "  --memory BYTES       physical memory (default 256)\n"
+            "  --address-bits N     virtual address width (default %d)\n"
+            "  --policy NAME        lru, clock, 2q, arc or lfu (default lru)\n"
+            "  --io syscall|mmap    how pages move to and from the files\n"
+            "  --async off|auto|uring|threads   asynchronous swap I/O\n"
+            "  --tlb N              software TLB entries, 0 turns it off\n"
+            "  --readahead N        largest exec read-ahead window in pages, 0 turns it off\n"
+            "  --levels N           page table levels, 2 (flat, default), 3 or 4 (radix)\n"
+            "  --zswap BYTES        compressed swap pool budget, 0 turns it off\n"
+            "  --pageout-low N      free frames under which the page-out daemon evicts, 0 turns it off\n"
+            "  --pageout-high N     free frames it evicts up to (default twice --pageout-low)\n"
+            "  --pageout-clean N    dirty pages near eviction it writes back per run (default 8)\n"
+            "  --pageout-interval N accesses between its runs (default 64)\n"
+            "  --restore PATH       start from a checkpoint (see save_checkpoint)\n"
+            "  --save-checkpoint PATH   checkpoint the simulator after the replay\n"
+            "  --reader mmap|read   how the trace is streamed (default mmap)\n"
+            "  --stats FILE         write stats snapshots to FILE (- for stdout)\n"
+            "  --stats-interval N   accesses between snapshots (default 1000000)\n"
+            "  --stats-format json|csv\n",
+            program, program, ADDRESS_SIZE);
+}
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int convert(const char* input, const char* output, const char* to, trace_io reader_io) {
+    trace_reader reader;
+    if(!reader.open(input, reader_io)) {
+        fprintf(stderr, "ERR: can't read trace %s\n", input);
+        return 1;
+    }
+    trace_format format = reader.format() == TRACE_BINARY ? TRACE_TEXT : TRACE_BINARY;
+    if(to != nullptr)
+        format = strcmp(to, "text") == 0 ? TRACE_TEXT : TRACE_BINARY;
+    trace_writer writer;
+    if(!writer.open(output, format)) {
+        fprintf(stderr, "ERR: can't write trace %s\n", output);
+        return 1;
+    }
+    trace_record record;
+    long records = 0;
+    while (reader.next(&record)) {
+        if(!writer.write(record)) {
+            fprintf(stderr, "ERR: write to %s failed\n", output);
+            return 1;
+        }
+        records++;
+    }
+    if(reader.failed()) {
+        fprintf(stderr, "ERR: malformed record %ld in %s\n", records + 1, input);
+        return 1;
+    }
+    if(!writer.close()) {
+        fprintf(stderr, "ERR: write to %s failed\n", output);
+        return 1;
+    }
+    printf("converted %ld records to %s (%s)\n", records, output, format == TRACE_TEXT ? "text" : "binary");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* exec_file = "exec_file";
+    const char* swap_file = "swap_file";
+    int text = 1024, data = 1024, bss = 1024, heap = 1024, page_size = 16;
+    const char* convert_output = nullptr;
+    const char* convert_format = nullptr;
+    const char* restore_path = nullptr;
+    const char* checkpoint_path = nullptr;
+    trace_io reader_io = TRACE_MMAP;
+    sim_config config;
+    config.memory_size = 256;
+    config.stats_interval = 1000000; // only used with --stats
+
+    static const struct option options[] = {
+            {"exec", required_argument, nullptr, 'e'},
+            {"swap", required_argument, nullptr, 's'},
+            {"text", required_argument, nullptr, 'T'},
+            {"data", required_argument, nullptr, 'D'},
+            {"bss", required_argument, nullptr, 'B'},
+            {"heap", required_argument, nullptr, 'H'},
+            {"page", required_argument, nullptr, 'p'},
+            {"text-page", required_argument, nullptr, '0'},
+            {"data-page", required_argument, nullptr, '1'},
+            {"bss-page", required_argument, nullptr, '2'},
+            {"heap-page", required_argument, nullptr, '3'},
+            {"promote", required_argument, nullptr, 'g'},
+            {"memory", required_argument, nullptr, 'm'},
+            {"address-bits", required_argument, nullptr, 'a'},
+            {"policy", required_argument, nullptr, 'P'},
+            {"io", required_argument, nullptr, 'i'},
+            {"async", required_argument, nullptr, 'A'},
+            {"tlb", required_argument, nullptr, 't'},
+            {"readahead", required_argument, nullptr, 'R'},
+            {"levels", required_argument, nullptr, 'L'},
+            {"zswap", required_argument, nullptr, 'Z'},
+            {"pageout-low", required_argument, nullptr, 'w'},
+            {"pageout-high", required_argument, nullptr, 'W'},
+            {"pageout-clean", required_argument, nullptr, 'C'},
+            {"pageout-interval", required_argument, nullptr, 'N'},
+            {"restore", required_argument, nullptr, 'x'},
+            {"save-checkpoint", required_argument, nullptr, 'k'},
+            {"reader", required_argument, nullptr, 'r'},
+            {"stats", required_argument, nullptr, 'S'},
+            {"stats-interval", required_argument, nullptr, 'I'},
+            {"stats-format", required_argument, nullptr, 'F'},
+            {"convert", required_argument, nullptr, 'c'},
+            {"to", required_argument, nullptr, 'o'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (option) {
+            case 'e': exec_file = optarg; break;
+            case 's': swap_file = optarg; break;
+            case 'T': text = atoi(optarg); break;
+            case 'D': data = atoi(optarg); break;
+            case 'B': bss = atoi(optarg); break;
+            case 'H': heap = atoi(optarg); break;
+            case 'p': page_size = atoi(optarg); break;
+            case '0':
+            case '1':
+            case '2':
+            case '3': config.segment_page_size[option - '0'] = atoi(optarg); break;
+            case 'g': config.promote_order = atoi(optarg); break;
+            case 'm': config.memory_size = atoll(optarg); break;
+            case 'a': config.address_size = atoi(optarg); break;
+            case 'P':
+                if(!parse_policy(optarg, &config.policy)) {
+                    fprintf(stderr, "ERR: unknown policy %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i': config.io = strcmp(optarg, "mmap") == 0 ? MMAP_IO : SYSCALL_IO; break;
+            case 'A':
+                if(strcmp(optarg, "auto") == 0) config.async_io = ASYNC_AUTO;
+                else if(strcmp(optarg, "uring") == 0) config.async_io = ASYNC_URING;
+                else if(strcmp(optarg, "threads") == 0) config.async_io = ASYNC_THREADS;
+                else config.async_io = ASYNC_OFF;
+                break;
+            case 't': config.tlb_entries = atoi(optarg); break;
+            case 'R': config.readahead_max = atoi(optarg); break;
+            case 'L': config.page_table_levels = atoi(optarg); break;
+            case 'Z': config.zswap_budget = atoll(optarg); break;
+            case 'w': config.pageout_low = atoi(optarg); break;
+            case 'W': config.pageout_high = atoi(optarg); break;
+            case 'C': config.pageout_clean = atoi(optarg); break;
+            case 'N': config.pageout_interval = atol(optarg); break;
+            case 'x': restore_path = optarg; break;
+            case 'k': checkpoint_path = optarg; break;
+            case 'r': reader_io = strcmp(optarg, "read") == 0 ? TRACE_READ : TRACE_MMAP; break;
+            case 'S': config.stats_output = optarg; break;
+            case 'I': config.stats_interval = atol(optarg); break;
+            case 'F': config.stats_output_format = strcmp(optarg, "csv") == 0 ? STATS_CSV : STATS_JSON; break;
+            case 'c': convert_output = optarg; break;
+            case 'o': convert_format = optarg; break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if(optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* trace_path = argv[optind];
+    if(convert_output != nullptr)
+        return convert(trace_path, convert_output, convert_format, reader_io);
+
+    trace_reader reader;
+    if(!reader.open(trace_path, reader_io)) {
+        fprintf(stderr, "ERR: can't read trace %s\n", trace_path);
+        return 1;
+    }
+    sim_mem mem(exec_file, swap_file, text, data, bss, heap, page_size, config);
+    if(restore_path != nullptr && !mem.restore_checkpoint(restore_path)) {
+        fprintf(stderr, "ERR: can't restore %s\n", restore_path);
+        return 1;
+    }
+
+    trace_record record;
+    long loads = 0, stores = 0;
+    char checksum = 0;
+    double start = now_seconds();
+    while (reader.next(&record)) {
+        if(record.op == TRACE_LOAD) {
+            checksum ^= mem.load(record.address);
+            loads++;
+        }
+        else {
+            mem.store(record.address, record.value);
+            stores++;
+        }
+    }
+    double elapsed = now_seconds() - start;
+    if(reader.failed()) {
+        fprintf(stderr, "ERR: malformed record %ld in %s\n", loads + stores + 1, trace_path);
+        return 1;
+    }
+    if(checkpoint_path != nullptr && !mem.save_checkpoint(checkpoint_path)) {
+        fprintf(stderr, "ERR: can't save %s\n", checkpoint_path);
+        return 1;
+    }
+
+    long accesses = loads + stores;
+    swap_usage swap = mem.swap_slot_usage();
+    segment_stats total = mem.stats().total();
+    printf("trace        %s (%s)\n", trace_path, reader.format() == TRACE_BINARY ? "binary" : "text");
+    printf("accesses     %ld (%ld loads, %ld stores)\n", accesses, loads, stores);
+    printf("seconds      %.3f\n", elapsed);
+    printf("accesses/s   %.0f\n", elapsed > 0 ? accesses / elapsed : 0.0);
+    printf("faults       %ld (%ld major, %ld minor)\n", total.major_faults + total.minor_faults,
+           total.major_faults, total.minor_faults);
+    printf("evictions    %ld (%ld dirty)\n", total.clean_evictions + total.dirty_evictions, total.dirty_evictions);
+    printf("fault p50    %llu ns (major), %llu ns (minor)\n",
+           (unsigned long long)mem.stats().major_fault_ns.percentile(50),
+           (unsigned long long)mem.stats().minor_fault_ns.percentile(50));
+    printf("fault p99    %llu ns (major), %llu ns (minor)\n",
+           (unsigned long long)mem.stats().major_fault_ns.percentile(99),
+           (unsigned long long)mem.stats().minor_fault_ns.percentile(99));
+    printf("prefetch     %ld pages (%ld hits, %ld wasted)\n", total.prefetched, total.prefetch_hits,
+           total.prefetch_waste);
+    printf("page table   %zu bytes (%d levels)\n", mem.page_table_bytes(), config.page_table_levels);
+    tlb_usage tlb = mem.tlb_stats();
+    if(tlb.entries > 0)
+        printf("tlb          %ld hits, %ld misses\n", tlb.hits, tlb.misses);
+    if(total.large_faults + total.large_ios + total.promotions > 0)
+        printf("large pages  %ld faults mapped %ld pages, %ld swap I/Os moved %ld pages, %ld promotions, %ld demotions\n",
+               total.large_faults, total.large_fault_pages, total.large_ios, total.large_io_pages, total.promotions,
+               total.demotions);
+    if(config.pageout_low > 0)
+        printf("pageout      %ld faults reclaimed directly, %ld pages evicted and %ld written back in the background\n",
+               total.direct_reclaims, total.background_reclaims, total.writebacks);
+    if(config.zswap_budget > 0) {
+        zswap_usage pool = mem.zswap_stats();
+        printf("zswap        %ld stores (%ld same-filled now, %ld rejected), ratio %.2f, %ld/%ld hits, %ld spills\n",
+               pool.stores, (long)pool.same_filled_pages, pool.rejected, pool.ratio, pool.hits, pool.loads,
+               pool.spills);
+    }
+    printf("swap reads   %ld\n", swap.reads);
+    printf("swap writes  %ld\n", swap.writes);
+    printf("checksum     %d\n", checksum);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "sim_stats.h"
+
+#include <cstring>
+
+void latency_histogram::reset() {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+    min_value = UINT64_MAX;
+    max_value = 0;
+    sum = 0;
+}
+
+uint64_t latency_histogram::percentile(double p) const {
+    if(total == 0)
+        return 0;
+    long wanted = (long)(p / 100.0 * total + 0.5);
+    if(wanted < 1)
+        wanted = 1;
+    long seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if(seen < wanted)
+            continue;
+        if(bucket < SUB_BUCKETS)
+            return bucket;
+        int shift = bucket / SUB_BUCKETS - 1;
+        uint64_t low = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        uint64_t high = low + ((1ULL << shift) - 1);
+        return high < max_value ? high : max_value;
+    }
+    return max_value;
+}
+
+segment_stats sim_stats::total() const {
+    segment_stats sum = segment_stats{};
+    for (const segment_stats& segment : segments) {
+        sum.hits += segment.hits;
+        sum.minor_faults += segment.minor_faults;
+        sum.major_faults += segment.major_faults;
+        sum.clean_evictions += segment.clean_evictions;
+        sum.dirty_evictions += segment.dirty_evictions;
+        sum.swap_ins += segment.swap_ins;
+        sum.swap_outs += segment.swap_outs;
+        sum.io_bytes += segment.io_bytes;
+        sum.exec_reads += segment.exec_reads;
+        sum.prefetched += segment.prefetched;
+        sum.prefetch_hits += segment.prefetch_hits;
+        sum.prefetch_waste += segment.prefetch_waste;
+        sum.large_faults += segment.large_faults;
+        sum.large_fault_pages += segment.large_fault_pages;
+        sum.large_ios += segment.large_ios;
+        sum.large_io_pages += segment.large_io_pages;
+        sum.promotions += segment.promotions;
+        sum.demotions += segment.demotions;
+        sum.direct_reclaims += segment.direct_reclaims;
+        sum.background_reclaims += segment.background_reclaims;
+        sum.writebacks += segment.writebacks;
+    }
+    return sum;
+}
+
+const char* segment_name(int segment) {
+    switch (segment) {
+        case 0: return "text";
+        case 1: return "data";
+        case 2: return "bss";
+        case 3: return "heap_stack";
+        default: return "unknown";
+    }
+}
+
+static void write_segment_json(FILE* out, const segment_stats& s) {
+    fprintf(out, "{\"hits\":%ld,\"minor_faults\":%ld,\"major_faults\":%ld,\"clean_evictions\":%ld,"
+                 "\"dirty_evictions\":%ld,\"swap_ins\":%ld,\"swap_outs\":%ld,\"io_bytes\":%lld,\"exec_reads\":%ld,"
+                 "\"prefetched\":%ld,\"prefetch_hits\":%ld,\"prefetch_waste\":%ld,\"large_faults\":%ld,"
+                 "\"large_fault_pages\":%ld,\"large_ios\":%ld,\"large_io_pages\":%ld,\"promotions\":%ld,\"demotions\":%ld,"
+                 "\"direct_reclaims\":%ld,\"background_reclaims\":%ld,\"writebacks\":%ld}",
+            s.hits, s.minor_faults, s.major_faults, s.clean_evictions, s.dirty_evictions,
+            s.swap_ins, s.swap_outs, s.io_bytes, s.exec_reads, s.prefetched, s.prefetch_hits, s.prefetch_waste,
+            s.large_faults, s.large_fault_pages, s.large_ios, s.large_io_pages, s.promotions, s.demotions,
+            s.direct_reclaims, s.background_reclaims, s.writebacks);
+}
+
+static void write_histogram_json(FILE* out, const latency_histogram& h) {
+    fprintf(out, "{\"count\":%ld,\"min\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+            h.count(), (unsigned long long)h.min(), h.mean(),
+            (unsigned long long)h.percentile(50), (unsigned long long)h.percentile(90),
+            (unsigned long long)h.percentile(99), (unsigned long long)h.percentile(99.9),
+            (unsigned long long)h.max());
+}
+
+static void write_segment_csv(FILE* out, long accesses, const char* name, const segment_stats& s,
+                              const latency_histogram& minor, const latency_histogram& major) {
+    fprintf(out, "%ld,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%lld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%llu,%llu,%llu,%llu\n",
+            accesses, name, s.hits, s.minor_faults, s.major_faults, s.clean_evictions, s.dirty_evictions,
+            s.swap_ins, s.swap_outs, s.io_bytes, s.exec_reads, s.prefetched, s.prefetch_hits, s.prefetch_waste,
+            s.large_faults, s.large_fault_pages, s.large_ios, s.large_io_pages, s.promotions, s.demotions,
+            s.direct_reclaims, s.background_reclaims, s.writebacks,
+            (unsigned long long)minor.percentile(50), (unsigned long long)minor.percentile(99),
+            (unsigned long long)major.percentile(50), (unsigned long long)major.percentile(99));
+}
+
+void write_stats_header(FILE* out, stats_format format) {
+    if(format == STATS_CSV)
+        fprintf(out, "accesses,segment,hits,minor_faults,major_faults,clean_evictions,dirty_evictions,"
+                     "swap_ins,swap_outs,io_bytes,exec_reads,prefetched,prefetch_hits,prefetch_waste,large_faults,large_fault_pages,large_ios,large_io_pages,promotions,demotions,"
+                     "direct_reclaims,background_reclaims,writebacks,"
+                     "minor_p50_ns,minor_p99_ns,major_p50_ns,major_p99_ns\n");
+}
+
+void write_stats(FILE* out, const sim_stats& stats, stats_format format) {
+    if(format == STATS_CSV) {
+        // the fault latencies aren't kept per segment, every row carries the overall ones
+        for (int segment = 0; segment < STATS_SEGMENTS; segment++)
+            write_segment_csv(out, stats.accesses, segment_name(segment), stats.segments[segment],
+                              stats.minor_fault_ns, stats.major_fault_ns);
+        write_segment_csv(out, stats.accesses, "total", stats.total(), stats.minor_fault_ns, stats.major_fault_ns);
+    }
+    else {
+        fprintf(out, "{\"accesses\":%ld,\"segments\":{", stats.accesses);
+        for (int segment = 0; segment < STATS_SEGMENTS; segment++) {
+            fprintf(out, "%s\"%s\":", segment == 0 ? "" : ",", segment_name(segment));
+            write_segment_json(out, stats.segments[segment]);
+        }
+        fprintf(out, "},\"total\":");
+        write_segment_json(out, stats.total());
+        fprintf(out, ",\"minor_fault_ns\":");
+        write_histogram_json(out, stats.minor_fault_ns);
+        fprintf(out, ",\"major_fault_ns\":");
+        write_histogram_json(out, stats.major_fault_ns);
+        fprintf(out, "}\n");
+    }
+    fflush(out);
+}
@@ -0,0 +1,251 @@
+#ifndef OS_EX4_SIM_STATS_H
+#define OS_EX4_SIM_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+// counters are on unless the build says otherwise (-DSIM_MEM_STATS=0), then every update
+// compiles to nothing
+#ifndef SIM_MEM_STATS
+#define SIM_MEM_STATS 1
+#endif
+
+// same as sim_mem.h
+#define STATS_SEGMENTS 4
+
+// how stats snapshots are written
+enum stats_format {
+    STATS_JSON, // one JSON object per line
+    STATS_CSV   // one row per segment (and a total row) per snapshot
+};
+
+// log-linear histogram in the spirit of HdrHistogram: a value lands in the bucket of its power
+// of two, split into SUB_BUCKETS linear steps, so every recorded value is known to within
+// 1/SUB_BUCKETS from nanoseconds up to the whole 64 bit range in a fixed array
+class latency_histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+private:
+    long counts[BUCKETS];
+    long total;
+    uint64_t min_value;
+    uint64_t max_value;
+    long double sum;
+
+    static int bucketOf(uint64_t value) {
+        if(value < (uint64_t)SUB_BUCKETS)
+            return (int)value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+public:
+    latency_histogram() { reset(); }
+    void reset();
+
+    void record(uint64_t value) {
+        counts[bucketOf(value)]++;
+        total++;
+        sum += value;
+        if(value < min_value)
+            min_value = value;
+        if(value > max_value)
+            max_value = value;
+    }
+
+    long count() const { return total; }
+    uint64_t min() const { return total == 0 ? 0 : min_value; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total == 0 ? 0 : (double)(sum / total); }
+    // the highest value of the bucket holding the given percentile (0-100), 0 when empty
+    uint64_t percentile(double p) const;
+};
+
+// what happened to the pages of one segment
+typedef struct segment_stats {
+    long hits;
+    long minor_faults;     // resolved without reading a file: zero-filled, or swapped in from async buffers
+    long major_faults;     // the page was read from the exec or the swap file
+    long clean_evictions;
+    long dirty_evictions;  // the page had to be written to the swap
+    long swap_ins;
+    long swap_outs;
+    long long io_bytes;    // read from and written to the exec and swap files
+    long exec_reads;
+    long prefetched;       // pages read ahead from the exec, on top of the faulting page
+    long prefetch_hits;    // read-ahead pages accessed before being evicted
+    long prefetch_waste;   // read-ahead pages evicted without being accessed
+    long large_faults;     // faults that mapped a whole large page
+    long large_fault_pages; // pages they mapped, with base pages each one touched is a fault of its own
+    long large_ios;        // swap transfers of a whole large page in a single read or write
+    long large_io_pages;   // pages they moved, with base pages each one is an I/O of its own
+    long promotions;       // groups of resident base pages turned into a large page
+    long demotions;        // large pages split back into base pages by an eviction
+    long direct_reclaims;  // faults that found no free frame and evicted a page themselves
+    long background_reclaims; // pages the page-out daemon evicted, counted in the evictions too
+    long writebacks;       // dirty pages the page-out daemon wrote to the swap and left resident
+} segment_stats;
+
+typedef struct sim_stats {
+    long accesses;         // load and store calls
+    segment_stats segments[STATS_SEGMENTS];
+    latency_histogram minor_fault_ns; // time from the fault to the page being mapped, eviction included
+    latency_histogram major_fault_ns;
+
+    segment_stats total() const;
+} sim_stats;
+
+const char* segment_name(int segment);
+
+// the CSV column names, nothing for JSON
+void write_stats_header(FILE* out, stats_format format);
+void write_stats(FILE* out, const sim_stats& stats, stats_format format);
+
+// the counters sim_mem keeps, with enabled == false every call is empty and gets inlined away.
+// once shared, the fault path updates (everything but access and hit) take the given mutex
+template<bool enabled>
+class stats_collector {
+    sim_stats data;
+    std::mutex* guard;
+
+    std::unique_lock<std::mutex> hold() {
+        return guard != nullptr ? std::unique_lock<std::mutex>(*guard) : std::unique_lock<std::mutex>();
+    }
+
+public:
+    stats_collector() : guard(nullptr) { reset(); }
+    void share(std::mutex* lock) { guard = lock; }
+    void reset() {
+        data.accesses = 0;
+        for (segment_stats& segment : data.segments)
+            segment = segment_stats{};
+        data.minor_fault_ns.reset();
+        data.major_fault_ns.reset();
+    }
+    const sim_stats& snapshot() const { return data; }
+    // a consistent copy while other threads may be updating
+    sim_stats copy() {
+        std::unique_lock<std::mutex> held = hold();
+        return data;
+    }
+
+    long access() {
+        if constexpr (enabled)
+            return ++data.accesses;
+        return 0;
+    }
+    void hit(int segment) {
+        if constexpr (enabled)
+            data.segments[segment].hits++;
+    }
+    // start of a fault, pass what it returns to fault()
+    uint64_t clock() const {
+        if constexpr (enabled)
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        return 0;
+    }
+    void fault(int segment, bool major, uint64_t started) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            uint64_t elapsed = clock() - started;
+            if(major) {
+                data.segments[segment].major_faults++;
+                data.major_fault_ns.record(elapsed);
+            }
+            else {
+                data.segments[segment].minor_faults++;
+                data.minor_fault_ns.record(elapsed);
+            }
+        }
+    }
+    void eviction(int segment, bool dirty) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            if(dirty)
+                data.segments[segment].dirty_evictions++;
+            else
+                data.segments[segment].clean_evictions++;
+        }
+    }
+    void swap_in(int segment, long bytes) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].swap_ins++;
+            data.segments[segment].io_bytes += bytes;
+        }
+    }
+    void swap_out(int segment, long bytes) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].swap_outs++;
+            data.segments[segment].io_bytes += bytes;
+        }
+    }
+    void exec_read(int segment, long bytes) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].exec_reads++;
+            data.segments[segment].io_bytes += bytes;
+        }
+    }
+    // read-ahead is single threaded, these never lock
+    void prefetch(int segment, long pages) {
+        if constexpr (enabled)
+            data.segments[segment].prefetched += pages;
+    }
+    void prefetch_hit(int segment) {
+        if constexpr (enabled)
+            data.segments[segment].prefetch_hits++;
+    }
+    void prefetch_waste(int segment) {
+        if constexpr (enabled)
+            data.segments[segment].prefetch_waste++;
+    }
+    // so are large pages
+    void large_fault(int segment, int pages) {
+        if constexpr (enabled) {
+            data.segments[segment].large_faults++;
+            data.segments[segment].large_fault_pages += pages;
+        }
+    }
+    void large_io(int segment, int pages) {
+        if constexpr (enabled) {
+            data.segments[segment].large_ios++;
+            data.segments[segment].large_io_pages += pages;
+        }
+    }
+    void promotion(int segment) {
+        if constexpr (enabled)
+            data.segments[segment].promotions++;
+    }
+    void demotion(int segment) {
+        if constexpr (enabled)
+            data.segments[segment].demotions++;
+    }
+    void direct_reclaim(int segment) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].direct_reclaims++;
+        }
+    }
+    void background_reclaim(int segment) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].background_reclaims++;
+        }
+    }
+    void writeback(int segment) {
+        if constexpr (enabled) {
+            std::unique_lock<std::mutex> held = hold();
+            data.segments[segment].writebacks++;
+        }
+    }
+};
+
+#endif //OS_EX4_SIM_STATS_H
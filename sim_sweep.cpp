@@ -0,0 +1,318 @@
+// replays one access trace against every combination of page size, memory size and policy, the
+// runs in parallel on a work-stealing pool. the trace is decoded once and shared read-only, each
+// run has its own sim_mem with a private physical memory and its own swap file in a temporary
+// directory. prints one table of the results.
+//
+//   sim_sweep [options] <trace>
+#include "sim_mem.h"
+#include "trace.h"
+#include "work_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+
+typedef struct sweep_run {
+    int page_size;
+    long long memory_size;
+    policy_type policy;
+    // results
+    long faults;
+    long major_faults;
+    long evictions;
+    long dirty_evictions;
+    long swap_reads;
+    long swap_writes;
+    long errors; // accesses sim_mem rejected with an ERR
+    double cpu_seconds; // of the thread running it, wall time would count the waits for a core
+} sweep_run;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options] <trace>\n"
+            "  --page BYTES,...     page sizes (default 16)\n"
+            "  --memory BYTES,...   physical memory sizes (default 256)\n"
+            "  --policy NAME,...    lru, clock, 2q, arc or lfu (default lru)\n"
+            "  --threads N          worker threads (default one per core)\n"
+            "  --tmpdir DIR         where the runs' swap files go (default $TMPDIR or /tmp)\n"
+            "  --exec FILE          exec file (default exec_file)\n"
+            "  --text/--data/--bss/--heap BYTES   segment sizes (default 1024 each)\n"
+            "  --address-bits N     virtual address width (default %d)\n"
+            "  --io syscall|mmap    how pages move to and from the files\n"
+            "  --tlb N              software TLB entries, 0 turns it off\n"
+            "  --readahead N        largest exec read-ahead window in pages, 0 turns it off\n"
+            "  --zswap BYTES        compressed swap pool budget, 0 turns it off\n"
+            "  --csv                a CSV table only\n"
+            "  --reader mmap|read   how the trace is read (default mmap)\n",
+            program, ADDRESS_SIZE);
+}
+
+// takes cout's place while the runs go: sim_mem prints an ERR line for every rejected access,
+// they're counted per thread instead of landing in the table. a run stays on one thread
+class error_counter : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        if(c == '\n')
+            lines++;
+        return c == EOF ? 0 : c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        lines += std::count(s, s + n, '\n');
+        return n;
+    }
+
+public:
+    static thread_local long lines;
+};
+
+thread_local long error_counter::lines = 0;
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double thread_cpu_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// a comma separated list of numbers, false if any of them isn't one
+static bool parse_list(const char* list, std::vector<long long>* values) {
+    values->clear();
+    for (const char* next = list; *next != '\0'; ) {
+        char* end;
+        long long value = strtoll(next, &end, 10);
+        if(end == next || value <= 0 || (*end != ',' && *end != '\0'))
+            return false;
+        values->push_back(value);
+        next = *end == ',' ? end + 1 : end;
+    }
+    return !values->empty();
+}
+
+// the checks sim_mem's constructor would exit on for the settings a sweep varies, made before
+// any run starts so a bad combination doesn't exit from a worker and leave the swap directory
+static bool valid_run(long long page_size, long long memory_size, const int sizes[NUM_OF_SEGMENTS],
+                      const sim_config& config) {
+    if(page_size <= 0 || page_size > INT_MAX || memory_size < page_size || memory_size / page_size > MAX_FRAMES)
+        return false;
+    for (int seg = 0; seg < NUM_OF_SEGMENTS; seg++) {
+        if(sizes[seg] < 0)
+            return false;
+    }
+    return config.address_size <= 64 && config.segment_bits >= 2 && config.segment_bits < config.address_size;
+}
+
+static void replay(const decoded_trace& trace, const char* exec_file, const std::string& swap_file, int sizes[4],
+                   sim_config config, sweep_run* run) {
+    config.memory_size = run->memory_size;
+    config.policy = run->policy;
+    double start = thread_cpu_seconds();
+    long errors = error_counter::lines;
+    {
+        sim_mem mem(exec_file, swap_file.c_str(), sizes[TEXT_SEGMENT], sizes[DATA_SEGMENT], sizes[BSS_SEGMENT],
+                    sizes[HEAP_STACK_SEGMENT], run->page_size, config);
+        for (size_t i = 0; i < trace.size(); i++) {
+            trace_record record = trace.at(i);
+            if(record.op == TRACE_LOAD)
+                mem.load(record.address);
+            else
+                mem.store(record.address, record.value);
+        }
+        swap_usage swap = mem.swap_slot_usage();
+        segment_stats total = mem.stats().total();
+        run->faults = total.major_faults + total.minor_faults;
+        run->major_faults = total.major_faults;
+        run->evictions = total.clean_evictions + total.dirty_evictions;
+        run->dirty_evictions = total.dirty_evictions;
+        run->swap_reads = swap.reads;
+        run->swap_writes = swap.writes;
+    }
+    run->cpu_seconds = thread_cpu_seconds() - start;
+    run->errors = error_counter::lines - errors;
+    unlink(swap_file.c_str());
+}
+
+int main(int argc, char** argv) {
+    const char* exec_file = "exec_file";
+    const char* tmpdir = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : "/tmp";
+    int sizes[NUM_OF_SEGMENTS] = {1024, 1024, 1024, 1024};
+    std::vector<long long> page_sizes = {16}, memory_sizes = {256};
+    std::vector<policy_type> policies = {LRU_POLICY};
+    int threads = (int)std::thread::hardware_concurrency();
+    bool csv = false;
+    trace_io reader_io = TRACE_MMAP;
+    sim_config config;
+
+    static const struct option options[] = {
+            {"page", required_argument, nullptr, 'p'},
+            {"memory", required_argument, nullptr, 'm'},
+            {"policy", required_argument, nullptr, 'P'},
+            {"threads", required_argument, nullptr, 'j'},
+            {"tmpdir", required_argument, nullptr, 'd'},
+            {"exec", required_argument, nullptr, 'e'},
+            {"text", required_argument, nullptr, 'T'},
+            {"data", required_argument, nullptr, 'D'},
+            {"bss", required_argument, nullptr, 'B'},
+            {"heap", required_argument, nullptr, 'H'},
+            {"address-bits", required_argument, nullptr, 'a'},
+            {"io", required_argument, nullptr, 'i'},
+            {"tlb", required_argument, nullptr, 't'},
+            {"readahead", required_argument, nullptr, 'R'},
+            {"zswap", required_argument, nullptr, 'Z'},
+            {"csv", no_argument, nullptr, 'c'},
+            {"reader", required_argument, nullptr, 'r'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+    };
+    int option;
+    std::vector<long long> values;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (option) {
+            case 'p':
+            case 'm':
+                if(!parse_list(optarg, &values)) {
+                    fprintf(stderr, "ERR: bad list %s\n", optarg);
+                    return 1;
+                }
+                (option == 'p' ? page_sizes : memory_sizes) = values;
+                break;
+            case 'P': {
+                policies.clear();
+                std::string list = optarg;
+                for (size_t start = 0; start <= list.size(); ) {
+                    size_t comma = list.find(',', start);
+                    if(comma == std::string::npos)
+                        comma = list.size();
+                    policy_type policy;
+                    if(!parse_policy(list.substr(start, comma - start).c_str(), &policy)) {
+                        fprintf(stderr, "ERR: unknown policy in %s\n", optarg);
+                        return 1;
+                    }
+                    policies.push_back(policy);
+                    start = comma + 1;
+                }
+                break;
+            }
+            case 'j': threads = atoi(optarg); break;
+            case 'd': tmpdir = optarg; break;
+            case 'e': exec_file = optarg; break;
+            case 'T': sizes[TEXT_SEGMENT] = atoi(optarg); break;
+            case 'D': sizes[DATA_SEGMENT] = atoi(optarg); break;
+            case 'B': sizes[BSS_SEGMENT] = atoi(optarg); break;
+            case 'H': sizes[HEAP_STACK_SEGMENT] = atoi(optarg); break;
+            case 'a': config.address_size = atoi(optarg); break;
+            case 'i': config.io = strcmp(optarg, "mmap") == 0 ? MMAP_IO : SYSCALL_IO; break;
+            case 't': config.tlb_entries = atoi(optarg); break;
+            case 'R': config.readahead_max = atoi(optarg); break;
+            case 'Z': config.zswap_budget = atoll(optarg); break;
+            case 'c': csv = true; break;
+            case 'r': reader_io = strcmp(optarg, "read") == 0 ? TRACE_READ : TRACE_MMAP; break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if(optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* trace_path = argv[optind];
+
+    double start = now_seconds();
+    decoded_trace trace;
+    if(!trace.load(trace_path, reader_io)) {
+        if(trace.failed())
+            fprintf(stderr, "ERR: malformed record %zu in %s\n", trace.size() + 1, trace_path);
+        else
+            fprintf(stderr, "ERR: can't read trace %s\n", trace_path);
+        return 1;
+    }
+    double decode_seconds = now_seconds() - start;
+
+    int exec = open(exec_file, O_RDONLY);
+    if(exec == -1) {
+        fprintf(stderr, "ERR: can't open exec file %s\n", exec_file);
+        return 1;
+    }
+    close(exec);
+    for (long long page_size : page_sizes) {
+        for (long long memory_size : memory_sizes) {
+            if(!valid_run(page_size, memory_size, sizes, config)) {
+                fprintf(stderr, "ERR: page size %lld with memory %lld isn't a valid configuration\n", page_size,
+                        memory_size);
+                return 1;
+            }
+        }
+    }
+
+    std::string dir = std::string(tmpdir) + "/sim_sweep.XXXXXX";
+    if(mkdtemp(&dir[0]) == nullptr) {
+        perror("ERR");
+        return 1;
+    }
+    std::vector<sweep_run> runs;
+    for (long long page_size : page_sizes) {
+        for (long long memory_size : memory_sizes) {
+            for (policy_type policy : policies) {
+                sweep_run run;
+                memset(&run, 0, sizeof(run));
+                run.page_size = (int)page_size;
+                run.memory_size = memory_size;
+                run.policy = policy;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    start = now_seconds();
+    long steals;
+    error_counter errors;
+    std::streambuf* output = std::cout.rdbuf(&errors);
+    {
+        work_stealing_pool pool(threads);
+        for (size_t i = 0; i < runs.size(); i++) {
+            std::string swap_file = dir + "/swap_" + std::to_string(i);
+            sweep_run* run = &runs[i];
+            pool.submit([&trace, exec_file, swap_file, &sizes, config, run] {
+                replay(trace, exec_file, swap_file, sizes, config, run);
+            });
+        }
+        pool.wait();
+        threads = pool.size();
+        steals = pool.steal_count();
+    }
+    std::cout.rdbuf(output);
+    double wall = now_seconds() - start;
+    rmdir(dir.c_str());
+
+    double busy = 0;
+    if(csv)
+        printf("page_size,memory_bytes,policy,faults,major_faults,evictions,dirty_evictions,swap_reads,swap_writes,errors,"
+               "cpu_seconds\n");
+    else
+        printf("%6s %12s %6s %12s %12s %12s %12s %12s %12s %9s %9s\n", "page", "memory", "policy", "faults", "major",
+               "evictions", "dirty", "swap_reads", "swap_writes", "errors", "cpu_s");
+    for (const sweep_run& run : runs) {
+        busy += run.cpu_seconds;
+        printf(csv ? "%d,%lld,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.3f\n"
+                   : "%6d %12lld %6s %12ld %12ld %12ld %12ld %12ld %12ld %9ld %9.3f\n",
+               run.page_size, run.memory_size, policy_name(run.policy), run.faults, run.major_faults, run.evictions,
+               run.dirty_evictions, run.swap_reads, run.swap_writes, run.errors, run.cpu_seconds);
+    }
+    if(!csv) {
+        printf("\ntrace        %s, %zu accesses decoded once in %.3f s\n", trace_path, trace.size(), decode_seconds);
+        printf("runs         %zu on %d threads (%ld stolen)\n", runs.size(), threads, steals);
+        printf("seconds      %.3f wall, %.3f cpu in the runs (%.2f cores busy)\n", wall, busy, wall > 0 ? busy / wall : 0.0);
+        printf("accesses/s   %.0f over all runs\n", wall > 0 ? trace.size() * runs.size() / wall : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "soft_tlb.h"
+
+void soft_tlb::init(int num_entries, int num_ways) {
+    entries.clear();
+    next_way.clear();
+    hits = misses = 0;
+    if(num_entries <= 0)
+        return;
+    ways = num_ways < 1 ? 1 : num_ways;
+    if(ways > num_entries)
+        ways = num_entries;
+    int sets = 1;
+    while (sets * 2 * ways <= num_entries)
+        sets *= 2;
+    set_mask = sets - 1;
+    entries.assign((size_t)sets * ways, tlb_entry{EMPTY_VPN, nullptr, -1, -1, false, 0});
+    next_way.assign(sets, 0);
+}
+
+void soft_tlb::insert(uint64_t vpn, char* base, int frame, int segment, bool dirty, int order) {
+    if(!enabled())
+        return;
+    uint64_t set_index = (vpn >> order) & set_mask;
+    tlb_entry* set = &entries[set_index * ways];
+    // refresh the page's entry if it's there, otherwise take a free way or the round robin one
+    int target = -1;
+    for (int way = 0; way < ways && target == -1; way++)
+        if(set[way].vpn == vpn && set[way].order == order)
+            target = way;
+    for (int way = 0; way < ways && target == -1; way++)
+        if(set[way].vpn == EMPTY_VPN)
+            target = way;
+    if(target == -1) {
+        target = next_way[set_index];
+        next_way[set_index] = (target + 1) % ways;
+    }
+    set[target] = tlb_entry{vpn, base, frame, segment, dirty, (unsigned char)order};
+}
+
+void soft_tlb::invalidate(uint64_t vpn, int order) {
+    if(!enabled())
+        return;
+    tlb_entry* set = &entries[((vpn >> order) & set_mask) * ways];
+    for (int way = 0; way < ways; way++)
+        if(set[way].vpn == vpn && set[way].order == order)
+            set[way].vpn = EMPTY_VPN;
+}
+
+void soft_tlb::flush() {
+    for (tlb_entry& entry : entries)
+        entry.vpn = EMPTY_VPN;
+}
@@ -0,0 +1,82 @@
+#ifndef OS_EX4_SOFT_TLB_H
+#define OS_EX4_SOFT_TLB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one cached translation, a virtual page number straight to the frame holding it
+struct tlb_entry {
+    uint64_t vpn;  // EMPTY_VPN when the entry is unused
+    char* base;    // first byte of the frame
+    int frame;
+    int segment;   // for the hit counters
+    bool dirty;    // stores may skip the page table, the page is already dirty
+    unsigned char order; // the entry maps the aligned 2^order pages from vpn, frames from frame on
+};
+
+// a set-associative software TLB (ways == 1 is direct-mapped). a hit on a hot page is one
+// compare per way and one indexed read, with no trip through the page table. entries have to
+// be dropped by whoever takes a page out of its frame.
+class soft_tlb {
+    std::vector<tlb_entry> entries;
+    std::vector<int> next_way; // per set, the way the next fill replaces
+    int ways;
+    uint64_t set_mask;
+    long hits;
+    long misses;
+
+public:
+    static const uint64_t EMPTY_VPN = ~0ULL;
+
+    soft_tlb() : ways(1), set_mask(0), hits(0), misses(0) {}
+    // num_entries is rounded down to a power of two sets of ways, 0 disables the TLB
+    void init(int num_entries, int num_ways);
+
+    bool enabled() const { return !entries.empty(); }
+
+    // only valid on an enabled TLB
+    tlb_entry* lookup(uint64_t vpn) {
+        tlb_entry* set = &entries[(vpn & set_mask) * ways];
+        for (int way = 0; way < ways; way++) {
+            if(set[way].vpn == vpn) {
+                hits++;
+                return &set[way];
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+    // a lookup that also finds the entry of a large page, the aligned group of 2^order pages
+    // holding vpn. a large page's entry is tagged with its first page and sits in the set of
+    // vpn >> order, so a TLB of large pages uses all of its sets
+    tlb_entry* lookup(uint64_t vpn, int order) {
+        if(order == 0)
+            return lookup(vpn);
+        uint64_t first = vpn & ~((1ULL << order) - 1);
+        for (int pass = 0; pass < 2; pass++) {
+            uint64_t tag = pass == 0 ? vpn : first;
+            int shift = pass == 0 ? 0 : order;
+            tlb_entry* set = &entries[((tag >> shift) & set_mask) * ways];
+            for (int way = 0; way < ways; way++) {
+                if(set[way].vpn == tag && set[way].order == shift) {
+                    hits++;
+                    return &set[way];
+                }
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    void insert(uint64_t vpn, char* base, int frame, int segment, bool dirty, int order = 0);
+    void invalidate(uint64_t vpn, int order = 0);
+    void flush();
+
+    int capacity() const { return (int)entries.size(); }
+    int associativity() const { return ways; }
+    long hit_count() const { return hits; }
+    long miss_count() const { return misses; }
+};
+
+#endif //OS_EX4_SOFT_TLB_H
@@ -0,0 +1,330 @@
+#include "trace.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// bytes read per buffer in TRACE_READ mode, and the room kept in front of them for the
+// undecoded tail of the previous buffer
+#define TRACE_CHUNK (1 << 20)
+#define TRACE_HEADROOM TRACE_MAX_LINE
+// in TRACE_MMAP mode decoded pages are given back this many bytes at a time
+#define TRACE_DROP_CHUNK (16 << 20)
+
+trace_reader::trace_reader()
+    : fd(-1), kind(TRACE_BINARY), io(TRACE_MMAP), error(false), previous(0),
+      cursor(nullptr), end(nullptr), at_eof(false), map_addr(nullptr), map_size(0), dropped(0),
+      filling(0), filled(0), stopping(false) {}
+
+trace_reader::~trace_reader() {
+    if(worker.joinable()) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return filled != -1; });
+            stopping = true;
+        }
+        ready.notify_all();
+        worker.join();
+    }
+    if(map_addr != nullptr)
+        munmap(map_addr, map_size);
+    if(fd != -1)
+        close(fd);
+}
+
+// worker thread of TRACE_READ, fills buffers[filling] whenever filled is set to -1
+void trace_reader::readAhead() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        ready.wait(guard, [this] { return filled == -1 || stopping; });
+        if(stopping)
+            return;
+        unsigned char* dst = buffers[filling].data() + TRACE_HEADROOM;
+        guard.unlock();
+        ssize_t total = 0;
+        while (total < TRACE_CHUNK) {
+            ssize_t n = ::read(fd, dst + total, TRACE_CHUNK - total);
+            if(n == 0)
+                break;
+            if(n < 0) {
+                total = -2;
+                break;
+            }
+            total += n;
+        }
+        guard.lock();
+        filled = total;
+        ready.notify_all();
+    }
+}
+
+void trace_reader::startFill() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        filled = -1;
+    }
+    ready.notify_all();
+}
+
+// makes at least wanted (<= TRACE_MAX_LINE) bytes available at cursor if the file has them,
+// false if it ends sooner
+bool trace_reader::refill(size_t wanted) {
+    while ((size_t)(end - cursor) < wanted) {
+        if(at_eof || io == TRACE_MMAP)
+            return false;
+        ssize_t n;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return filled != -1; });
+            n = filled;
+        }
+        if(n == -2) {
+            error = true;
+            n = 0;
+        }
+        // the undecoded tail moves in front of the fresh bytes
+        size_t tail = end - cursor;
+        unsigned char* start = buffers[filling].data() + TRACE_HEADROOM - tail;
+        memmove(start, cursor, tail);
+        cursor = start;
+        end = buffers[filling].data() + TRACE_HEADROOM + n;
+        filling = 1 - filling;
+        if(n < TRACE_CHUNK)
+            at_eof = true;
+        else
+            startFill();
+    }
+    return true;
+}
+
+bool trace_reader::open(const char* path, trace_io mode) {
+    fd = ::open(path, O_RDONLY);
+    if(fd == -1)
+        return false;
+    io = mode;
+    struct stat st;
+    if(io == TRACE_MMAP && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr != MAP_FAILED) {
+            map_addr = (unsigned char*)addr;
+            map_size = st.st_size;
+            madvise(map_addr, map_size, MADV_SEQUENTIAL);
+        }
+    }
+    if(map_addr != nullptr) {
+        cursor = map_addr;
+        end = map_addr + map_size;
+        at_eof = true;
+    }
+    else if(io == TRACE_MMAP && fstat(fd, &st) == 0 && st.st_size == 0) {
+        at_eof = true; // an empty trace, nothing to map
+    }
+    else {
+        io = TRACE_READ;
+        buffers[0].resize(TRACE_HEADROOM + TRACE_CHUNK);
+        buffers[1].resize(TRACE_HEADROOM + TRACE_CHUNK);
+        cursor = end = buffers[1].data() + TRACE_HEADROOM;
+        worker = std::thread(&trace_reader::readAhead, this);
+        startFill();
+    }
+
+    refill(TRACE_HEADER_SIZE);
+    if((size_t)(end - cursor) >= TRACE_HEADER_SIZE && memcmp(cursor, TRACE_MAGIC, 7) == 0) {
+        if(cursor[7] != TRACE_VERSION) {
+            error = true;
+            return false;
+        }
+        kind = TRACE_BINARY;
+        cursor += TRACE_HEADER_SIZE;
+    }
+    else {
+        kind = TRACE_TEXT;
+    }
+    return true;
+}
+
+bool trace_reader::nextBinary(trace_record* record) {
+    if((size_t)(end - cursor) < TRACE_MAX_RECORD)
+        refill(TRACE_MAX_RECORD);
+    if(cursor == end)
+        return false;
+    const unsigned char* p = cursor;
+    unsigned op = *p++;
+    if(op > TRACE_STORE) {
+        error = true;
+        return false;
+    }
+    uint64_t zigzag = 0;
+    for (int shift = 0; ; shift += 7) {
+        if(p == end || shift > 63) {
+            error = true;
+            return false;
+        }
+        unsigned char byte = *p++;
+        zigzag |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            break;
+    }
+    previous += (zigzag >> 1) ^ (0 - (zigzag & 1));
+    record->op = (trace_op)op;
+    record->address = previous;
+    if(op == TRACE_STORE) {
+        if(p == end) {
+            error = true;
+            return false;
+        }
+        record->value = (char)*p++;
+    }
+    cursor = p;
+    return true;
+}
+
+bool trace_reader::nextText(trace_record* record) {
+    while (true) {
+        if((size_t)(end - cursor) < TRACE_MAX_LINE)
+            refill(TRACE_MAX_LINE);
+        if(cursor == end)
+            return false;
+        const unsigned char* newline = (const unsigned char*)memchr(cursor, '\n', end - cursor);
+        const unsigned char* line_end = newline != nullptr ? newline : end;
+        if(line_end - cursor >= TRACE_MAX_LINE) {
+            error = true;
+            return false;
+        }
+        char text[TRACE_MAX_LINE + 1];
+        size_t length = line_end - cursor;
+        memcpy(text, cursor, length);
+        text[length] = '\0';
+        cursor = newline != nullptr ? newline + 1 : end;
+
+        char* p = text;
+        while (isspace((unsigned char)*p))
+            p++;
+        if(*p == '\0' || *p == '#')
+            continue;
+        char op = toupper((unsigned char)*p++);
+        if((op != 'L' && op != 'S') || !isspace((unsigned char)*p)) {
+            error = true;
+            return false;
+        }
+        char* after;
+        errno = 0;
+        record->address = strtoull(p, &after, 0);
+        if(after == p || errno != 0) {
+            error = true;
+            return false;
+        }
+        p = after;
+        while (isspace((unsigned char)*p))
+            p++;
+        if(op == 'L') {
+            record->op = TRACE_LOAD;
+        }
+        else {
+            record->op = TRACE_STORE;
+            if(p[0] == '\\' && p[1] == 'x' && isxdigit((unsigned char)p[2]) && isxdigit((unsigned char)p[3])) {
+                char hex[3] = {p[2], p[3], '\0'};
+                record->value = (char)strtol(hex, nullptr, 16);
+                p += 4;
+            }
+            else if(*p != '\0') {
+                record->value = *p++;
+            }
+            else {
+                error = true;
+                return false;
+            }
+        }
+        while (isspace((unsigned char)*p))
+            p++;
+        if(*p != '\0' && *p != '#') {
+            error = true;
+            return false;
+        }
+        return true;
+    }
+}
+
+bool trace_reader::next(trace_record* record) {
+    if(error)
+        return false;
+    // whatever was decoded is never looked at again, the kernel can have those pages back
+    if(map_addr != nullptr && (size_t)(cursor - map_addr) - dropped >= TRACE_DROP_CHUNK) {
+        madvise(map_addr + dropped, TRACE_DROP_CHUNK, MADV_DONTNEED);
+        dropped += TRACE_DROP_CHUNK;
+    }
+    return kind == TRACE_BINARY ? nextBinary(record) : nextText(record);
+}
+
+bool decoded_trace::load(const char* path, trace_io mode) {
+    addresses.clear();
+    ops.clear();
+    values.clear();
+    error = false;
+    trace_reader reader;
+    if(!reader.open(path, mode))
+        return false;
+    trace_record record;
+    while (reader.next(&record)) {
+        addresses.push_back(record.address);
+        ops.push_back((unsigned char)record.op);
+        values.push_back(record.op == TRACE_STORE ? record.value : '\0');
+    }
+    error = reader.failed();
+    return !error;
+}
+
+bool trace_writer::open(const char* path, trace_format format) {
+    file = fopen(path, "w");
+    if(file == nullptr)
+        return false;
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    kind = format;
+    previous = 0;
+    if(kind == TRACE_BINARY) {
+        char header[TRACE_HEADER_SIZE];
+        memcpy(header, TRACE_MAGIC, 7);
+        header[7] = TRACE_VERSION;
+        fwrite(header, 1, TRACE_HEADER_SIZE, file);
+    }
+    return true;
+}
+
+bool trace_writer::write(const trace_record& record) {
+    if(kind == TRACE_TEXT) {
+        unsigned char value = (unsigned char)record.value;
+        if(record.op == TRACE_LOAD)
+            return fprintf(file, "L 0x%llx\n", (unsigned long long)record.address) > 0;
+        if(isgraph(value) && value != '\\' && value != '#')
+            return fprintf(file, "S 0x%llx %c\n", (unsigned long long)record.address, value) > 0;
+        return fprintf(file, "S 0x%llx \\x%02x\n", (unsigned long long)record.address, value) > 0;
+    }
+    unsigned char bytes[TRACE_MAX_RECORD];
+    int n = 0;
+    bytes[n++] = (unsigned char)record.op;
+    int64_t delta = (int64_t)(record.address - previous);
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    do {
+        unsigned char byte = zigzag & 0x7f;
+        zigzag >>= 7;
+        bytes[n++] = byte | (zigzag != 0 ? 0x80 : 0);
+    } while (zigzag != 0);
+    if(record.op == TRACE_STORE)
+        bytes[n++] = (unsigned char)record.value;
+    previous = record.address;
+    return fwrite(bytes, 1, n, file) == (size_t)n;
+}
+
+bool trace_writer::close() {
+    if(file == nullptr)
+        return true;
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
@@ -0,0 +1,133 @@
+#ifndef OS_EX4_TRACE_H
+#define OS_EX4_TRACE_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// access traces for replaying against sim_mem.
+//
+// binary format: the 8 byte header "SMTRACE" + version (1), then one record per access:
+//   op byte (TRACE_LOAD or TRACE_STORE)
+//   address delta from the previous record, zigzag + LEB128 varint (the first one is from 0)
+//   value byte, stores only
+// text format: one access per line, "L <address>" or "S <address> <value>", the address in
+// decimal or 0x hex, the value a single character or \xNN. '#' starts a comment.
+
+#define TRACE_MAGIC "SMTRACE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 8
+#define TRACE_MAX_RECORD 12   // op + 10 byte varint + value
+#define TRACE_MAX_LINE 256
+
+enum trace_op { TRACE_LOAD = 0, TRACE_STORE = 1 };
+
+enum trace_format { TRACE_BINARY, TRACE_TEXT };
+
+// how a trace file is streamed, either way memory use doesn't grow with the trace
+enum trace_io {
+    TRACE_MMAP, // the file is mapped, pages already decoded are dropped as the cursor moves on
+    TRACE_READ  // read() into two buffers, a worker thread fills one while the other is decoded
+};
+
+typedef struct trace_record {
+    trace_op op;
+    uint64_t address;
+    char value; // stores only
+} trace_record;
+
+class trace_reader {
+    int fd;
+    trace_format kind;
+    trace_io io;
+    bool error;
+    uint64_t previous;      // address of the last binary record
+
+    // bytes not decoded yet are [cursor, end)
+    const unsigned char* cursor;
+    const unsigned char* end;
+    bool at_eof;            // nothing after end
+
+    // TRACE_MMAP
+    unsigned char* map_addr;
+    size_t map_size;
+    size_t dropped;         // bytes at the front of the mapping already given back
+
+    // TRACE_READ, the worker fills buffers[filling] while buffers[1 - filling] is decoded
+    std::vector<unsigned char> buffers[2];
+    int filling;
+    ssize_t filled;         // bytes the worker read into buffers[filling], -1 while it's busy
+    bool stopping;
+    std::mutex lock;
+    std::condition_variable ready;
+    std::thread worker;
+
+    void readAhead();
+    void startFill();
+    bool refill(size_t wanted);
+    bool nextBinary(trace_record* record);
+    bool nextText(trace_record* record);
+
+public:
+    trace_reader();
+    ~trace_reader();
+    trace_reader(const trace_reader&) = delete;
+    trace_reader& operator=(const trace_reader&) = delete;
+
+    // opens a trace and tells binary from text by the header, false if it can't be opened
+    bool open(const char* path, trace_io mode = TRACE_MMAP);
+    // false at the end of the trace or on a malformed record (failed() tells them apart)
+    bool next(trace_record* record);
+    bool failed() const { return error; }
+    trace_format format() const { return kind; }
+};
+
+// a whole trace decoded once into memory, 10 bytes an access, for replaying it many times. it's
+// only read after load, so any number of threads can replay it at once
+class decoded_trace {
+    std::vector<uint64_t> addresses;
+    std::vector<unsigned char> ops;
+    std::vector<char> values;
+    bool error;
+
+public:
+    decoded_trace() : error(false) {}
+
+    // false if the trace can't be opened or has a malformed record (failed() tells them apart,
+    // size() is then the number of records before it)
+    bool load(const char* path, trace_io mode = TRACE_MMAP);
+    bool failed() const { return error; }
+    size_t size() const { return addresses.size(); }
+    trace_record at(size_t i) const {
+        trace_record record;
+        record.op = (trace_op)ops[i];
+        record.address = addresses[i];
+        record.value = values[i];
+        return record;
+    }
+};
+
+class trace_writer {
+    FILE* file;
+    trace_format kind;
+    uint64_t previous;
+
+public:
+    trace_writer() : file(nullptr), kind(TRACE_BINARY), previous(0) {}
+    ~trace_writer() { close(); }
+    trace_writer(const trace_writer&) = delete;
+    trace_writer& operator=(const trace_writer&) = delete;
+
+    bool open(const char* path, trace_format format);
+    bool write(const trace_record& record);
+    // false if anything couldn't be written
+    bool close();
+};
+
+#endif //OS_EX4_TRACE_H
@@ -0,0 +1,83 @@
+#include "work_pool.h"
+
+work_stealing_pool::work_stealing_pool(int threads)
+    : queued(0), running(0), stopping(false), next_queue(0), steals(0) {
+    if(threads < 1)
+        threads = 1;
+    for (int i = 0; i < threads; i++)
+        queues.emplace_back(new task_queue());
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(&work_stealing_pool::work, this, i);
+}
+
+work_stealing_pool::~work_stealing_pool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void work_stealing_pool::submit(std::function<void()> task) {
+    std::unique_lock<std::mutex> guard(lock);
+    task_queue& queue = *queues[next_queue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> queue_guard(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+    queued++;
+    guard.unlock();
+    work_ready.notify_one();
+}
+
+void work_stealing_pool::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    all_done.wait(guard, [this] { return queued == 0 && running == 0; });
+}
+
+// the newest task of the worker's own queue, or else the oldest of the first other queue that
+// has one. false when every queue is empty
+bool work_stealing_pool::take(int worker, std::function<void()>* task) {
+    int count = (int)queues.size();
+    for (int i = 0; i < count; i++) {
+        task_queue& queue = *queues[(worker + i) % count];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if(queue.tasks.empty())
+            continue;
+        if(i == 0) {
+            *task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            *task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    return false;
+}
+
+void work_stealing_pool::work(int worker) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            work_ready.wait(guard, [this] { return queued > 0 || stopping; });
+            if(queued == 0)
+                return; // stopping
+            // counted before the task is found, the one queued task is then this worker's
+            queued--;
+            running++;
+        }
+        std::function<void()> task;
+        while (!take(worker, &task)) {} // submit queues a task before counting it
+        task();
+        std::lock_guard<std::mutex> guard(lock);
+        running--;
+        if(queued == 0 && running == 0)
+            all_done.notify_all();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef OS_EX4_WORK_POOL_H
+#define OS_EX4_WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads with a deque of tasks each. submit deals tasks out round-robin,
+// a worker takes its own newest task and, with none left, steals the oldest of another worker,
+// so runs of uneven length still keep every thread busy. meant for coarse tasks (a whole
+// simulation each), a deque is guarded by its own lock rather than being lock-free
+class work_stealing_pool {
+    struct task_queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex lock;                 // guards the counts below, for the waits
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    int queued;                      // tasks submitted and not taken yet
+    int running;
+    bool stopping;
+    unsigned next_queue;
+    std::atomic<long> steals;
+
+    bool take(int worker, std::function<void()>* task);
+    void work(int worker);
+
+public:
+    explicit work_stealing_pool(int threads);
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+    // waits for the tasks already submitted
+    ~work_stealing_pool();
+
+    void submit(std::function<void()> task);
+    // blocks until every task submitted so far has finished
+    void wait();
+    int size() const { return (int)workers.size(); }
+    // tasks a worker took from another one's queue
+    long steal_count() const { return steals.load(std::memory_order_relaxed); }
+};
+
+#endif //OS_EX4_WORK_POOL_H